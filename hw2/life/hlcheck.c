@@ -0,0 +1,150 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         hlcheck.c
+* Description:  Checks Hashlife against the grid kernels
+*
+*******************************************************************************
+*/
+
+/*
+ * Hashlife plays on an unbounded plane and the grid kernels on a board
+ * with dead edges, so the two agree for as long as the pattern keeps
+ * clear of the edges.  Each check prints a line, and hlcheck exits
+ * non-zero if any of them fails:
+ *
+ *  - soup over all of a window, loaded and stored back untouched, down
+ *    to row 0 and column 0;
+ *  - soup in the middle of a large window, evolved by Hashlife with a
+ *    mix of step sizes and by evolve_grid one generation at a time.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "tools/grid.h"
+#include "tools/hashlife.h"
+
+#define W    512                /* window of the evolution check */
+#define SOUP 64                 /* soup at its centre */
+
+/*
+ * checksum:
+ *  FNV-1a over the cells of a w-by-h grid
+ *
+ */
+static uint64_t
+checksum(const unsigned char *g, int w, int h, int stride)
+{
+  uint64_t sum = 0xcbf29ce484222325ULL;
+  int x, y;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      sum = (sum ^ g[y * stride + x]) * 0x100000001b3ULL;
+  return sum;
+} /* checksum */
+
+/*
+ * soup:
+ *  Fills the n-by-m rectangle at (x0, y0) with one cell in three alive
+ *
+ */
+static void
+soup(unsigned char *g, int stride, int x0, int y0, int n, int m)
+{
+  uint64_t s = 0x9e3779b97f4a7c15ULL;
+  int x, y;
+
+  for (y = y0; y < y0 + m; y++)
+    for (x = x0; x < x0 + n; x++) {
+      s ^= s << 13;
+      s ^= s >> 7;
+      s ^= s << 17;
+      g[y * stride + x] = s % 3 == 0;
+    }
+} /* soup */
+
+/*
+ * round_trip:
+ *  A window loaded into Hashlife and stored straight back is the same
+ *
+ */
+static int
+round_trip(struct hashlife *hl)
+{
+  int w = 100, h = 77, stride;
+  unsigned char *g = grid_new(w, h, &stride);
+  unsigned char *out = grid_new(w, h, &stride);
+  int ok;
+
+  if (g == NULL || out == NULL) {
+    perror("round_trip");
+    exit(EXIT_FAILURE);
+  }
+  soup(g, stride, 0, 0, w, h);
+  ok = hl_load(hl, g, w, h, stride) == 0;
+  hl_store(hl, out, w, h, stride);
+  ok = ok && checksum(g, w, h, stride) == checksum(out, w, h, stride);
+  printf("round trip   %dx%d: %s\n", w, h, ok ? "ok" : "FAILED");
+  grid_free(g, stride);
+  grid_free(out, stride);
+  return ok;
+} /* round_trip */
+
+/*
+ * evolution:
+ *  Hashlife and evolve_grid come to the same window
+ *
+ */
+static int
+evolution(struct hashlife *hl)
+{
+  static const int steps[] = { 0, 3, 1, 5, 2, 4, 0 };
+  int i, n, gens = 0, stride, ok;
+  unsigned char *g[2], *out;
+  uint64_t want;
+
+  g[0] = grid_new(W, W, &stride);
+  g[1] = grid_new(W, W, &stride);
+  out = grid_new(W, W, &stride);
+  if (g[0] == NULL || g[1] == NULL || out == NULL) {
+    perror("evolution");
+    exit(EXIT_FAILURE);
+  }
+  soup(g[0], stride, (W - SOUP) / 2, (W - SOUP) / 2, SOUP, SOUP);
+  ok = hl_load(hl, g[0], W, W, stride) == 0;
+  for (i = 0; ok && i < (int)(sizeof(steps) / sizeof(steps[0])); i++) {
+    ok = hl_step(hl, steps[i]) == 0;
+    gens += 1 << steps[i];
+  }
+  for (n = 0; n < gens; n++)
+    evolve_grid(g[n & 1], g[(n & 1) ^ 1], W, W, stride);
+  want = checksum(g[gens & 1], W, W, stride);
+  hl_store(hl, out, W, W, stride);
+  ok = ok && checksum(out, W, W, stride) == want;
+  printf("evolution    %d generations of %dx%d soup: %s\n", gens, SOUP, SOUP,
+         ok ? "ok" : "FAILED");
+  grid_free(g[0], stride);
+  grid_free(g[1], stride);
+  grid_free(out, stride);
+  return ok;
+} /* evolution */
+
+int
+main(void)
+{
+  struct hashlife *hl;
+  int ok;
+
+  grid_kernel_init(NULL);
+  if ((hl = hl_new((size_t)64 << 20)) == NULL) {
+    perror("hlcheck");
+    exit(EXIT_FAILURE);
+  }
+  ok = round_trip(hl);
+  ok = evolution(hl) && ok;
+  hl_free(hl);
+  exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+} /* main */
@@ -51,18 +51,109 @@
  *
  */
 
+#include <errno.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/resource.h>
 #include <unistd.h>
-#include "tools/tools.h"
+#include "tools/grid.h"
+#include "tools/pool.h"
+#include "tools/board.h"
+#include "tools/hashlife.h"
+#include "tools/tiles.h"
+#include "tools/display.h"
+#include "tools/rng.h"
+#include "tools/packed.h"
+#include "tools/pattern.h"
+#include "tools/rule.h"
+#include "tools/cycle.h"
+#include "tools/census.h"
+#include "tools/block.h"
+#include "tools/stats.h"
+#include "tools/checkpoint.h"
+#include "tools/dist.h"
+#include "tools/jump.h"
+#include "tools/traffic.h"
 
 #define SLEEPT 200000
+#define CKPT_TRIES 3    /* checkpoints lost in a row before giving up */
+#define CYCLE_EVERY 64  /* generations between hashes of a plain grid */
 
 int keep_playing = 1;
 
+/*
+ * What to play, as read from the command line
+ *
+ */
+struct options {
+  int w, h;
+  int threads;
+  int procs;            /* processes to split the board across, 0 for one */
+  int scaling;
+  int hashlife;         /* log2 of generations per frame, -1 to step */
+  size_t hlmem;         /* Hashlife cache cap in bytes */
+  int tiles;            /* tile size for sparse evolution, 0 for none */
+  int block;            /* block side for temporal blocking, 0 for none */
+  int block_gens;       /* generations per blocked pass */
+  int packed;           /* evolve the board bit-packed, on one thread */
+  int pages;            /* report the pages the board ended up on */
+  const char *stats;    /* log each generation to this file */
+  const char *checkpoint;       /* checkpoint the board to this file */
+  double checkpoint_every;      /* ... this many seconds apart */
+  struct board *resumed;        /* start from this instead of soup */
+  unsigned long long resumed_gen;       /* ... at this generation */
+  double fps;           /* frame rate cap, 0 for none */
+  int every;            /* show one generation in every */
+  int topology;         /* BOARD_DEAD, BOARD_TORUS or BOARD_PLANE */
+  long bench;           /* generations to run headless, 0 to play */
+  unsigned long long jump;      /* generations to jump at once, 0 for none */
+  unsigned seed;
+  const char *kernel;   /* grid kernel picked at startup, or asked for */
+  struct rule rule;
+  struct packed *pattern;       /* start from this instead of soup */
+  const char *output;   /* pattern file to save the board to */
+  unsigned long long output_at; /* generation to save at, 0 at the end */
+  int cycle;            /* generations watched for repeats, 0 for none */
+  long census;          /* soups to run for a census, 0 for none */
+  unsigned long long max_gens;  /* census soups still running are dropped */
+};
+
+/*
+ * The board and whichever engine evolves it
+ *
+ */
+struct engine {
+  const struct options *o;
+  struct board *b;
+  struct pool *pool;
+  struct hashlife *hl;
+  struct tiles *tiles;
+  struct block *block;  /* scratch for blocked passes, if blocking */
+  struct packed *packed;        /* the board, if evolved bit-packed; b
+                                   then only catches up when read */
+  unsigned long long unpacked;  /* ... the generation b is at */
+  struct dist *dist;    /* the bands, if split across processes; b is
+                           then only a copy for when all of it is wanted */
+  struct stats *stats;  /* per-generation log, if kept */
+  struct stats_rec rec; /* ... and its record of the current frame */
+  struct checkpoint *ckpt;      /* checkpoints being written, if kept */
+  uint64_t ckpt_due;    /* stats_clock() of the next checkpoint */
+  unsigned long ckpt_lost;      /* checkpoints lost, as reported so far */
+  int failed;           /* something the run was to save was not */
+  unsigned long long gen;
+  long active;          /* tiles recomputed by the last step */
+  int saved;            /* o->output has been written */
+  struct cycle *cycle;  /* recent board hashes, if watching for repeats */
+  unsigned long long period;    /* the board repeats every period gens */
+  unsigned long long since;     /* ... starting from this one */
+};
+
+static const char *topologies[] = { "dead", "torus", "plane" };
+
 /*
  * handler:
  *   Deal with SIGINTs.
@@ -76,32 +167,921 @@ void handler(int signo) {
     }
 } /* handler */
 
+/*
+ * soup:
+ *   Fills rows [y0, y1) of b with random soup, one cell in ten alive,
+ *   row y from stream first + y of the seed
+ *
+ */
+static void
+soup(struct board *b, unsigned seed, uint64_t first, int y0, int y1)
+{
+  struct rng r;
+  int y;
+
+  for (y = y0; y < y1; y++) {
+    rng_seed(&r, seed, first + y);
+    rng_fill(&r, BOARD_CUR(b) + y * b->stride, b->w, 0.1);
+  }
+} /* soup */
+
+static void
+seed_rows(void *arg, int y0, int y1)
+{
+  struct engine *e = arg;
+
+  soup(e->b, e->o->seed, 0, y0, y1);
+} /* seed_rows */
+
+/*
+ * seed:
+ *   Fills the board with random soup.  Row y always comes from stream
+ *   y of the seed, so the soup only depends on the seed and the size,
+ *   not on the number of threads.
+ *
+ */
+static void
+seed(struct engine *e)
+{
+  pool_run(e->pool, seed_rows, e, e->b->h);
+} /* seed */
+
+/*
+ * fill_band:
+ *   Fills rows [y0, y1) of the board, starting at g, as engine_start
+ *   would the whole board, for a process of its own
+ *
+ */
+static void
+fill_band(void *arg, unsigned char *g, int stride, int y0, int y1)
+{
+  const struct options *o = arg;
+  struct rng r;
+  int y;
+
+  if (o->pattern != NULL) {
+    packed_to_grid(o->pattern, g, o->w, y1 - y0, stride,
+                   (o->w - o->pattern->w) / 2, (o->h - o->pattern->h) / 2 - y0);
+    return;
+  }
+  for (y = y0; y < y1; y++) {
+    rng_seed(&r, o->seed, y);
+    rng_fill(&r, g + (y - y0) * stride, o->w, 0.1);
+  }
+} /* fill_band */
+
+/*
+ * engine_start:
+ *   Seeds a board and sets up the engine chosen in o
+ *
+ */
+static void
+engine_start(struct engine *e, const struct options *o)
+{
+  memset(e, 0, sizeof(*e));
+  e->o = o;
+  /* before any thread is started, as the children would not have it */
+  if (o->procs > 0) {
+    e->dist = dist_new(o->w, o->h, o->procs, o->topology, fill_band,
+                       (void *)o);
+    e->pool = pool_new(1);
+    if (e->dist == NULL || e->pool == NULL) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+    /* main turns down every other engine and option with it */
+    return;
+  }
+  e->b = o->resumed != NULL ? o->resumed : board_new(o->w, o->h);
+  e->pool = pool_new(o->threads);
+  if (e->b == NULL || e->pool == NULL) {
+    perror("engine_start");
+    exit(EXIT_FAILURE);
+  }
+  /* a resumed board comes filled in, and where it has grown to */
+  e->gen = o->resumed_gen;
+  if (o->resumed == NULL) {
+    board_touch(e->b, e->pool);
+    e->b->topology = o->topology;
+    if (o->pattern != NULL)
+      packed_to_grid(o->pattern, BOARD_CUR(e->b), o->w, o->h, e->b->stride,
+                     (o->w - o->pattern->w) / 2, (o->h - o->pattern->h) / 2);
+    else
+      seed(e);
+  }
+
+  if (o->hashlife >= 0) {
+    e->hl = hl_new(o->hlmem);
+    if (e->hl != NULL)
+      hl_set_rule(e->hl, &o->rule);
+    if (e->hl == NULL
+        || hl_load(e->hl, BOARD_CUR(e->b), o->w, o->h, e->b->stride) != 0) {
+      fprintf(stderr, "engine_start: cannot start Hashlife\n");
+      exit(EXIT_FAILURE);
+    }
+  } else if (o->tiles > 0) {
+    if ((e->tiles = tiles_new(e->b, o->tiles)) == NULL) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+  } else if (o->block > 0) {
+    e->block = block_new(o->block, o->block_gens, pool_threads(e->pool));
+    if (e->block == NULL) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+  } else if (o->packed) {
+    if ((e->packed = packed_new(o->w, o->h)) == NULL) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+    packed_from_grid(e->packed, BOARD_CUR(e->b), e->b->stride);
+    e->unpacked = e->gen;
+  }
+
+  if (o->cycle > 0) {
+    if ((e->cycle = cycle_new(o->cycle)) == NULL) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+    if (board_hash_start(e->b) != 0) {
+      perror("engine_start");
+      exit(EXIT_FAILURE);
+    }
+    /* see engine_cycle; the generations it steps are not logged or saved */
+    if (e->hl == NULL && e->tiles == NULL && e->block == NULL
+        && o->stats == NULL && o->output_at == 0)
+      e->b->hash_every = e->b->hash_wait = CYCLE_EVERY;
+    cycle_check(e->cycle, e->b->hash.sum, e->gen);
+  }
+
+  if (o->stats != NULL) {
+    if ((e->stats = stats_open(o->stats)) == NULL) {
+      perror(o->stats);
+      exit(EXIT_FAILURE);
+    }
+    /* the other grid is still empty: nothing has been born yet */
+    stats_count(&e->rec, e->b, e->pool, 0);
+    e->rec.births = 0;
+    e->rec.gen = e->gen;
+  }
+
+  if (o->checkpoint != NULL) {
+    if ((e->ckpt = checkpoint_new(o->checkpoint)) == NULL) {
+      perror(o->checkpoint);
+      exit(EXIT_FAILURE);
+    }
+    e->ckpt_due = stats_clock() + (uint64_t)(o->checkpoint_every * 1e9);
+  }
+} /* engine_start */
+
+/*
+ * engine_checkpoint:
+ *   Hands the current generation to the checkpoint thread; with wait,
+ *   until it is on disk.  Reports checkpoints the thread could not
+ *   write.  Returns 1 if the thread is still busy with the one before,
+ *   -1 if out of memory, with wait if this one was lost, or if
+ *   CKPT_TRIES in a row were, after which no more are taken.
+ *
+ */
+static int
+engine_checkpoint(struct engine *e, int wait)
+{
+  struct checkpoint_meta m;
+  int r;
+
+  memset(&m, 0, sizeof(m));
+  m.gen = e->gen;
+  m.view_w = e->o->w;
+  m.view_h = e->o->h;
+  m.topology = e->b->topology;
+  memcpy(m.rule, e->o->rule.name, sizeof(m.rule));
+  if ((r = checkpoint_take(e->ckpt, e->b, &m, wait)) < 0) {
+    perror(e->o->checkpoint);
+    e->failed = 1;
+    return -1;
+  }
+  if (r == 1)
+    return 1;
+  /* taken, so the thread is done with the ones before */
+  if (e->ckpt->lost > e->ckpt_lost) {
+    e->ckpt_lost = e->ckpt->lost;
+    e->failed = 1;
+    fprintf(stderr, "%s: checkpoint lost: %s (%lu so far)\n",
+            e->o->checkpoint, strerror(e->ckpt->err), e->ckpt_lost);
+  }
+  if (e->ckpt->streak >= CKPT_TRIES) {
+    fprintf(stderr, "%s: giving up after %d checkpoints in a row were "
+            "lost\n", e->o->checkpoint, CKPT_TRIES);
+    checkpoint_free(e->ckpt);
+    e->ckpt = NULL;
+    return -1;
+  }
+  return wait && e->ckpt->streak > 0 ? -1 : 0;
+} /* engine_checkpoint */
+
+/*
+ * engine_gather:
+ *   Copies a board split across processes into e->b, which is only
+ *   made once the whole of it is wanted; -1 if out of memory
+ *
+ */
+static int
+engine_gather(struct engine *e)
+{
+  if (e->b == NULL && (e->b = board_new(e->o->w, e->o->h)) == NULL)
+    return -1;
+  dist_gather(e->dist, BOARD_CUR(e->b), e->b->stride);
+  return 0;
+} /* engine_gather */
+
+/*
+ * engine_unpack:
+ *   Brings e->b up to the packed board, which steps on its own
+ *
+ */
+static void
+engine_unpack(struct engine *e)
+{
+  int y;
+
+  if (e->packed == NULL || e->unpacked == e->gen)
+    return;
+  for (y = 0; y < e->b->h; y++)
+    memset(BOARD_CUR(e->b) + (size_t)y * e->b->stride, 0, e->b->w);
+  packed_to_grid(e->packed, BOARD_CUR(e->b), e->b->w, e->b->h, e->b->stride,
+                 0, 0);
+  e->unpacked = e->gen;
+} /* engine_unpack */
+
+/*
+ * engine_save:
+ *   Writes the board to o->output
+ *
+ */
+static void
+engine_save(struct engine *e)
+{
+  struct packed *p;
+
+  e->saved = 1;
+  if (e->dist != NULL && engine_gather(e) != 0) {
+    perror(e->o->output);
+    return;
+  }
+  engine_unpack(e);
+  p = packed_new(e->b->w, e->b->h);
+  if (p != NULL)
+    packed_from_grid(p, BOARD_CUR(e->b), e->b->stride);
+  if (p == NULL || pattern_save(p, e->o->rule.name, e->o->output) != 0)
+    perror(e->o->output);
+  packed_free(p);
+} /* engine_save */
+
+/*
+ * engine_log:
+ *   Writes the record of the current frame to the stats log, giving up
+ *   on the log if it cannot be written
+ *
+ */
+static void
+engine_log(struct engine *e)
+{
+  if (stats_write(e->stats, &e->rec) != 0) {
+    perror(e->o->stats);
+    stats_close(e->stats);
+    e->stats = NULL;
+  }
+} /* engine_log */
+
+/*
+ * engine_cycle:
+ *   Checks the hash of the current generation against those seen.  A
+ *   board hashed every frame repeats from the generation the hash was
+ *   seen at.  A plain grid is only hashed every CYCLE_EVERY
+ *   generations, as hashing costs it more than stepping does; there a
+ *   hash met again is confirmed, and the period found, by stepping on
+ *   until the cells are back, the repeat having begun by the
+ *   generation the hash was seen at.  Returns -1 if the board could not
+ *   be stepped.
+ *
+ */
+static int
+engine_cycle(struct engine *e)
+{
+  unsigned long long d = cycle_check(e->cycle, e->b->hash.sum, e->gen);
+  long long p;
+
+  if (d == 0)
+    return 0;
+  if (e->b->hash_every == 0) {
+    e->period = d;
+    e->since = e->gen - d;
+    return 0;
+  }
+  if ((p = board_period(e->b, e->pool, d)) < 0) {
+    fprintf(stderr, "engine_step: board too large\n");
+    return -1;
+  }
+  /* if the cells did not come back, two boards shared a hash */
+  e->since = e->gen - d;
+  e->gen += p != 0 ? (unsigned long long)p : d;
+  e->period = p;
+  return 0;
+} /* engine_cycle */
+
+/*
+ * engine_step:
+ *   Advances the board by one frame: one generation, 2^N with
+ *   Hashlife, or a blocked pass.  Returns -1 if the engine cannot go on.
+ *
+ */
+static int
+engine_step(struct engine *e)
+{
+  struct board *b = e->b;
+  uint64_t t = 0;
+  int r;
+
+  if (e->stats != NULL) {
+    engine_log(e);
+    t = stats_clock();
+  }
+  if (e->hl != NULL) {
+    if (hl_step(e->hl, e->o->hashlife) != 0) {
+      fprintf(stderr, "engine_step: universe too large\n");
+      return -1;
+    }
+    /* into the other grid, so the frame before stays for the stats */
+    hl_store(e->hl, BOARD_NEXT(b), b->w, b->h, b->stride);
+    board_swap(b);
+    e->gen = hl_generation(e->hl);
+    /* the board is redrawn each frame, and only what is in view counts */
+    if (e->cycle != NULL && board_hash_start(b) != 0) {
+      perror("engine_step");
+      return -1;
+    }
+  } else if (e->dist != NULL) {
+    if (dist_run(e->dist, 1, &keep_playing) != 0) {
+      fprintf(stderr, "engine_step: a band process died\n");
+      return -1;
+    }
+    e->gen = e->dist->gen;
+  } else if (e->block != NULL) {
+    if (block_step(e->block, b, e->pool) != 0) {
+      perror("engine_step");
+      return -1;
+    }
+    e->gen += e->o->block_gens;
+    /* only every block_gens-th generation is seen */
+    if (e->cycle != NULL && board_hash_start(b) != 0) {
+      perror("engine_step");
+      return -1;
+    }
+  } else if (e->packed != NULL) {
+    evolve_packed(e->packed, &e->o->rule);
+    e->gen++;
+  } else {
+    if (e->tiles != NULL)
+      r = (e->active = tiles_step(e->tiles, b)) < 0 ? -1 : 0;
+    else
+      r = board_step(b, e->pool);
+    if (r != 0) {
+      fprintf(stderr, "engine_step: board too large\n");
+      return -1;
+    }
+    e->gen++;
+  }
+  if (e->stats != NULL) {
+    e->rec.evolve_ns = stats_clock() - t;
+    e->rec.render_ns = 0;
+    e->rec.gen = e->gen;
+    stats_count(&e->rec, b, e->pool, e->rec.population);
+  }
+  if (e->cycle != NULL && e->period == 0 && BOARD_HASHED(b)
+      && engine_cycle(e) != 0)
+    return -1;
+  if (e->o->output != NULL && e->o->output_at > 0 && !e->saved
+      && e->gen >= e->o->output_at)
+    engine_save(e);
+  /* while the one before is still being written, try again next step */
+  if (e->ckpt != NULL && (t = stats_clock()) >= e->ckpt_due) {
+    if ((r = engine_checkpoint(e, 0)) < 0)
+      return -1;
+    if (r == 0)
+      e->ckpt_due = t + (uint64_t)(e->o->checkpoint_every * 1e9);
+  }
+  return 0;
+} /* engine_step */
+
+/*
+ * engine_fate:
+ *   Describes how the board settled down, once it has
+ *
+ */
+static void
+engine_fate(const struct engine *e, char *buf, size_t len)
+{
+  int y, alive = 0;
+
+  for (y = 0; y < e->b->h && !alive; y++)
+    alive = memchr(BOARD_CUR(e->b) + y * e->b->stride, 1, e->b->w) != NULL;
+  if (!alive)
+    snprintf(buf, len, "dies out by generation %llu", e->since);
+  else if (e->period == 1)
+    snprintf(buf, len, "still life by generation %llu", e->since);
+  else
+    snprintf(buf, len, "period %llu by generation %llu",
+             e->period, e->since);
+} /* engine_fate */
+
+/*
+ * engine_pages:
+ *   Reports to f the pages that back the current generation
+ *
+ */
+static void
+engine_pages(const struct engine *e, FILE *f)
+{
+  long size, page, huge;
+
+  if (grid_pages(BOARD_CUR(e->b), &size, &page, &huge) != 0)
+    fprintf(f, "pages        unknown\n");
+  else if (page > 4096)
+    fprintf(f, "pages        %ld KB of %ld KB pages\n", size >> 10, page >> 10);
+  else
+    fprintf(f, "pages        %ld KB of %ld KB pages, %ld KB on transparent "
+            "huge pages\n", size >> 10, page >> 10, huge >> 10);
+} /* engine_pages */
+
+/*
+ * engine_stop:
+ *   Saves the board if that was left for the end, and tears down.
+ *   Returns -1 if a checkpoint was lost along the way.
+ *
+ */
+static int
+engine_stop(struct engine *e)
+{
+  int failed;
+
+
+  if (e->o->output != NULL && !e->saved)
+    engine_save(e);
+  if (e->stats != NULL) {
+    engine_log(e);
+    if (e->stats != NULL && stats_close(e->stats) != 0)
+      perror(e->o->stats);
+  }
+  if (e->ckpt != NULL) {
+    engine_checkpoint(e, 1);
+    /* anything lost before the last one has been reported already */
+    if (checkpoint_free(e->ckpt) != 0 && !e->failed) {
+      perror(e->o->checkpoint);
+      e->failed = 1;
+    }
+  }
+  failed = e->failed;
+  cycle_free(e->cycle);
+  tiles_free(e->tiles);
+  block_free(e->block);
+  packed_free(e->packed);
+  dist_free(e->dist);
+  hl_free(e->hl);
+  pool_free(e->pool);
+  board_free(e->b);
+  return failed ? -1 : 0;
+} /* engine_stop */
+
 /*
  * game:
- *   All the action is here; creates and manipulates the array
+ *   All the action is here; creates and manipulates the array.  The
+ *   board is drawn on a thread of its own, so the terminal never holds
+ *   evolution back; with a frame rate set, the drawing thread keeps to
+ *   it and shows the latest of every o->every-th generation posted.
  *   
  */
-void 
-game(int w, int h)
-{
-  int x, y, rounds, round;
-  unsigned univ[h][w];
-  
-  for (x = 0; x < w; x++) {
-    for (y = 0; y < h; y++) {
-      rounds = rand() % 200000;
-      for (round = 0; round < rounds; round++) {
-        univ[y][x] = rand() < RAND_MAX / 10 ? 1 : 0;
+int
+game(const struct options *o)
+{
+  struct engine e;
+  struct display *d;
+  char status[80] = "", fate[64];
+  unsigned long long frame;
+
+  engine_start(&e, o);
+  d = display_new(o->w, o->h, STDOUT_FILENO, o->fps);
+  if (d == NULL) {
+    perror("game");
+    exit(EXIT_FAILURE);
+  }
+
+  for (frame = 0; keep_playing; frame++) {
+    if (frame % o->every == 0 || e.period != 0) {
+      uint64_t t = e.stats != NULL ? stats_clock() : 0;
+
+      if (e.dist != NULL && engine_gather(&e) != 0) {
+        perror("game");
+        break;
       }
+      engine_unpack(&e);
+      display_post(d, BOARD_VIEW(e.b), e.b->stride, status);
+      if (e.stats != NULL)
+        e.rec.render_ns = stats_clock() - t;
+      if (__atomic_load_n(&d->failed, __ATOMIC_ACQUIRE))
+        break;
+      if (e.period != 0)
+        break;
     }
+    if (engine_step(&e) != 0)
+      break;
+    if (e.tiles != NULL)
+      snprintf(status, sizeof(status), "generation %llu: %ld of %d tiles active",
+               e.gen, e.active, e.tiles->nx * e.tiles->ny);
+    else
+      snprintf(status, sizeof(status), "generation %llu", e.gen);
+    if (e.period != 0) {
+      engine_fate(&e, fate, sizeof(fate));
+      snprintf(status, sizeof(status), "generation %llu: %s", e.gen, fate);
+    }
+    if (d->dropped > 0)
+      snprintf(status + strlen(status), sizeof(status) - strlen(status),
+               " (%llu frames dropped)", d->dropped);
   }
 
-  while (keep_playing) {
-    show(univ, w, h);
-    evolve(univ, w, h);
-    usleep(SLEEPT);
-  }
+  display_free(d);
+  if (o->pages)
+    engine_pages(&e, stderr);
+  return engine_stop(&e);
 } /* game */
+
+/*
+ * now:
+ *   Monotonic time in seconds
+ *
+ */
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+} /* now */
+
+/*
+ * scaling:
+ *   Times board_step on a random board with 1 to o->threads threads
+ *   and prints the speedup over one thread
+ *
+ */
+int
+scaling(const struct options *o)
+{
+  int i, n, gens = 20, w = o->w, h = o->h;
+  double base = 0, secs;
+  struct engine e;
+  struct board *b;
+  struct pool *pool;
+
+  engine_start(&e, o);
+  b = e.b;
+
+  printf("%dx%d, %d generations, kernel %s\n", w, h, gens, o->kernel);
+  printf("threads   ms/gen  speedup\n");
+  for (n = 1; n <= o->threads; n++) {
+    pool = pool_new(n);
+    if (pool == NULL) {
+      perror("pool_new");
+      exit(EXIT_FAILURE);
+    }
+    secs = now();
+    for (i = 0; i < gens; i++)
+      board_step(b, pool);
+    secs = (now() - secs) / gens;
+    if (n == 1)
+      base = secs;
+    printf("%7d %8.3f %8.2f\n", pool_threads(pool), secs * 1e3, base / secs);
+    pool_free(pool);
+  }
+
+  return engine_stop(&e);
+} /* scaling */
+
+/*
+ * bench:
+ *   Runs o->bench frames without rendering or sleeping and reports
+ *   the throughput, the memory traffic if the CPU counts it, and a
+ *   checksum of the final board
+ *
+ */
+int
+bench(const struct options *o)
+{
+  long i;
+  double secs, gens;
+  struct engine e;
+  struct rusage ru;
+  int r, fd, err = 0;
+  uint64_t bytes = 0, before = 0;
+
+  /* before the threads and band processes, for them to count too */
+  if ((fd = traffic_open()) < 0)
+    err = errno;
+  engine_start(&e, o);
+  if (fd >= 0 && traffic_read(fd, &before) != 0)
+    err = errno;
+  secs = now();
+  if (e.dist != NULL && o->output_at == 0) {
+    /* in one go: between, the halos alone keep the bands in step */
+    if (dist_run(e.dist, o->bench, &keep_playing) != 0)
+      fprintf(stderr, "bench: a band process died\n");
+    e.gen = e.dist->gen;
+  } else
+    for (i = 0; i < o->bench && keep_playing && e.period == 0; i++)
+      if (engine_step(&e) != 0)
+        break;
+  secs = now() - secs;
+  if (fd >= 0 && err == 0 && traffic_read(fd, &bytes) != 0)
+    err = errno;
+  traffic_close(fd);
+  bytes -= before;
+  gens = e.gen - o->resumed_gen;
+  getrusage(RUSAGE_SELF, &ru);
+
+  printf("engine       %s\n", e.hl != NULL ? "hashlife"
+                              : e.tiles != NULL ? "tiles"
+                              : e.block != NULL ? "blocked grid"
+                              : e.packed != NULL ? "packed" : "grid");
+  if (e.dist != NULL)
+    printf("kernel       %s, %d processes\n", o->kernel, o->procs);
+  else if (e.packed != NULL)
+    printf("kernel       64 cells a word, 1 thread\n");
+  else
+    printf("kernel       %s, %d threads\n", o->kernel, pool_threads(e.pool));
+  printf("board        %dx%d %s, %s, seed %u\n", o->w, o->h,
+         topologies[o->topology], o->rule.name, o->seed);
+  printf("generations  %.0f in %.3f s\n", gens, secs);
+  printf("gens/sec     %.1f\n", gens / secs);
+  /* Hashlife works on the universe, not cell by cell over the view */
+  if (e.hl == NULL)
+    printf("cells/sec    %.3e\n", gens * o->w * o->h / secs);
+  printf("peak RSS     %ld KB\n", ru.ru_maxrss);
+  if (o->pages)
+    engine_pages(&e, stdout);
+  if (e.block != NULL)
+    printf("blocking     %dx%d blocks, %d generations a pass\n",
+           o->block, o->block, o->block_gens);
+  /* read from memory, as last-level cache misses: see traffic.h */
+  if (err != 0)
+    printf("traffic      not measured: %s\n", strerror(err));
+  else if (e.hl != NULL)
+    printf("traffic      %.2f GB/s in\n", bytes / secs / 1e9);
+  else
+    printf("traffic      %.2f bytes/cell/gen, %.2f GB/s in\n",
+           bytes / (gens * o->w * o->h), bytes / secs / 1e9);
+  engine_unpack(&e);
+  /* the whole board, or universe, where the checksum is of the view */
+  printf("population   %llu\n", (unsigned long long)
+         (e.hl != NULL ? hl_population(e.hl)
+          : e.dist != NULL ? dist_population(e.dist)
+          : grid_population(BOARD_CUR(e.b), e.b->w, e.b->h, e.b->stride)));
+  printf("checksum     %016llx\n", (unsigned long long)
+         (e.dist != NULL ? dist_checksum(e.dist)
+          : grid_checksum(BOARD_VIEW(e.b), o->w, o->h, e.b->stride)));
+  if (e.cycle != NULL) {
+    char fate[64] = "none seen";
+
+    if (e.period != 0)
+      engine_fate(&e, fate, sizeof(fate));
+    printf("cycle        %s\n", fate);
+  }
+  r = engine_stop(&e);
+  if (o->procs > 0) {
+    /* the band processes are gone now, so their peak can be had */
+    getrusage(RUSAGE_CHILDREN, &ru);
+    printf("band RSS     %ld KB at most per process\n", ru.ru_maxrss);
+  }
+  return r;
+} /* bench */
+
+/*
+ * jump:
+ *   Jumps the board o->jump generations ahead in one go, the way that
+ *   suits it, and reports how and what it came to
+ *
+ */
+int
+jump(const struct options *o)
+{
+  double secs;
+  struct engine e;
+  struct jump *j;
+  int r;
+
+  engine_start(&e, o);
+  if ((j = jump_new(o->hlmem, e.pool)) == NULL) {
+    perror("jump");
+    exit(EXIT_FAILURE);
+  }
+  secs = now();
+  if ((r = jump_run(j, e.b, o->jump)) < 0) {
+    perror("jump");
+    exit(EXIT_FAILURE);
+  }
+  secs = now() - secs;
+  e.gen += o->jump;
+
+  printf("jump         %llu generations by %s in %.3f s\n", o->jump,
+         jump_how(j), secs);
+  printf("board        %dx%d %s, %s, seed %u\n", o->w, o->h,
+         topologies[o->topology], o->rule.name, o->seed);
+  if (j->period != 0)
+    printf("cycle        period %llu or a multiple of it\n", j->period);
+  printf("population   %llu\n", (unsigned long long)j->population);
+  if (r == 0)
+    printf("checksum     %016llx\n", (unsigned long long)
+           grid_checksum(BOARD_VIEW(e.b), o->w, o->h, e.b->stride));
+  else {
+    /* the board is still at the start, and not worth saving */
+    printf("checksum     none, the pattern outgrew the board\n");
+    e.saved = 1;
+  }
+  jump_free(j);
+  return engine_stop(&e);
+} /* jump */
+
+/*
+ * A census run shared by the threads: each takes the next soup until
+ * there are none left
+ *
+ */
+struct census_run {
+  const struct options *o;
+  struct census *census;
+  long next;                    /* the next soup to run */
+  long settled;                 /* soups that repeated and were counted */
+  unsigned long long gens;      /* generations run, all soups */
+  int failed;
+};
+
+/*
+ * census_soups:
+ *   Runs soups on one thread until they run out.  Soup i is seeded
+ *   from streams i << 32 on, so soup 0 is the board game() would play
+ *   and every soup is the same whatever thread runs it.
+ *
+ */
+static void
+census_soups(void *arg, int y0, int y1)
+{
+  struct census_run *run = arg;
+  const struct options *o = run->o;
+  struct cycle *c = cycle_new(o->cycle > 0 ? o->cycle : 64);
+  struct board *b;
+  unsigned long long gen, period, gens = 0;
+  long i;
+
+  (void)y0;
+  (void)y1;
+  while (c != NULL && keep_playing
+         && (i = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED))
+            < o->census) {
+    if ((b = board_new(o->w, o->h)) == NULL)
+      break;
+    b->topology = o->topology;
+    soup(b, o->seed, (uint64_t)i << 32, 0, b->h);
+    if (board_hash_start(b) != 0) {
+      board_free(b);
+      break;
+    }
+    cycle_reset(c);
+    cycle_check(c, b->hash.sum, 0);
+    /* gen counts the generations stepped, however the loop ends */
+    for (gen = 0, period = 0; gen < o->max_gens && period == 0; ) {
+      if (board_step(b, NULL) != 0)
+        break;
+      period = cycle_check(c, b->hash.sum, ++gen);
+    }
+    gens += gen;
+    if (period != 0) {
+      if (census_add(run->census, b, period) != 0) {
+        board_free(b);
+        break;
+      }
+      __atomic_fetch_add(&run->settled, 1, __ATOMIC_RELAXED);
+    }
+    board_free(b);
+  }
+  if (c == NULL || (keep_playing && run->next < o->census))
+    run->failed = 1;
+  __atomic_fetch_add(&run->gens, gens, __ATOMIC_RELAXED);
+  cycle_free(c);
+} /* census_soups */
+
+/*
+ * census:
+ *   Runs o->census soups on all threads, each until it repeats, and
+ *   prints a census of what they settle into
+ *
+ */
+void
+census(const struct options *o)
+{
+  double secs;
+  struct pool *pool = pool_new(o->threads);
+  struct census_run run = { o, census_new(), 0, 0, 0, 0 };
+
+  if (pool == NULL || run.census == NULL) {
+    perror("census");
+    exit(EXIT_FAILURE);
+  }
+  secs = now();
+  pool_run(pool, census_soups, &run, pool_threads(pool));
+  secs = now() - secs;
+  if (run.failed) {
+    perror("census");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("soups        %ld of %dx%d %s, %s, seed %u, %d threads\n",
+         run.next < o->census ? run.next : o->census, o->w, o->h,
+         topologies[o->topology], o->rule.name, o->seed, pool_threads(pool));
+  printf("settled      %ld, the rest still running after %llu generations\n",
+         run.settled, o->max_gens);
+  printf("generations  %llu in %.3f s, %.1f soups/sec\n", run.gens, secs,
+         (run.next < o->census ? run.next : o->census) / secs);
+  census_print(run.census, stdout);
+  census_free(run.census);
+  pool_free(pool);
+} /* census */
+
+/*
+ * usage:
+ *   Explains the command line and exits
+ *
+ */
+static void
+usage(const char *prog)
+{
+  fprintf(stderr,
+          "usage: %s [options] [w [h]]\n"
+          "  -t, --threads N   evolve with N threads (default: one per core)\n"
+          "      --procs N     split the board into N bands, each evolved by a\n"
+          "                    process of its own in its own shared memory;\n"
+          "                    dead or torus grid only\n"
+          "      --scaling     report the speedup from 1 to N threads\n"
+          "  -H, --hashlife N  advance 2^N generations per frame with Hashlife,\n"
+          "                    on an unbounded plane seen through the w-by-h board\n"
+          "      --hl-mem MB   Hashlife cache cap (default 256)\n"
+          "      --tiles[=N]   only evolve N-by-N tiles near recent changes\n"
+          "                    (default 64) and report the active tiles\n"
+          "      --block[=N]   evolve in N-by-N blocks that stay in cache, several\n"
+          "                    generations a pass (default: sized to the L2)\n"
+          "      --block-gens K  generations per blocked pass (default 8)\n"
+          "      --packed      evolve the board bit-packed, 64 cells a word, on\n"
+          "                    one thread; dead grid only\n"
+          "      --kernel K    evolve grids with kernel K: avx2, sse2 or scalar\n"
+          "                    (default: the widest this machine has)\n"
+          "      --pages       report the page sizes backing the board\n"
+          "      --fps N       show at most N frames a second, 0 for no cap\n"
+          "                    (default 5); the terminal never slows evolution,\n"
+          "                    frames it cannot keep up with are dropped\n"
+          "      --every N     show one generation in N, to fast-forward\n"
+          "  -b, --bench N     run N frames headless and report the throughput\n"
+          "      --jump N      jump N generations at once and report the board:\n"
+          "                    Hashlife on a plane, else step until the board\n"
+          "                    repeats and skip whole periods\n"
+          "      --seed N      seed the soup with N (default: the time, or 1\n"
+          "                    with --bench)\n"
+          "  -f, --file P      start from pattern file P (RLE or .cells) instead\n"
+          "                    of soup; w and h default to its size\n"
+          "  -o, --output P    save the board to P (RLE, or .cells by name)\n"
+          "      --output-at N save at generation N instead of at the end\n"
+          "      --stats P     log the population, births, deaths and the time\n"
+          "                    spent evolving and drawing each generation to P\n"
+          "                    (CSV if P ends in .csv, else binary)\n"
+          "      --checkpoint P  save the board to P every so often, so the run\n"
+          "                    can be resumed; only what changed is appended.\n"
+          "                    A lost checkpoint fails the run, and 3 in a\n"
+          "                    row stop it\n"
+          "      --checkpoint-every S  seconds between checkpoints (default 60)\n"
+          "      --resume P    carry on from checkpoint P, with its board, rule\n"
+          "                    and topology, checkpointing to P again\n"
+          "      --topology T  what lies past the edges: dead (default), torus\n"
+          "                    (wrap around) or plane (grow the board as needed)\n"
+          "  -r, --rule R      evolve under rule R in B/S notation, e.g. B36/S23\n"
+          "                    (default B3/S23); B0 rules need a bounded board\n"
+          "                    and no Hashlife or tiles\n"
+          "      --cycle[=N]   stop once the board repeats with a period of up\n"
+          "                    to N generations (default 64), reporting it\n"
+          "      --census N    run N w-by-h soups, each until it repeats, on\n"
+          "                    all threads and count the objects left; dead\n"
+          "                    or torus grid only\n"
+          "      --max-gens N  give up on a census soup after N generations\n"
+          "                    (default 100000)\n",
+          prog);
+  exit(EXIT_FAILURE);
+} /* usage */
  
 /*
  *
@@ -110,19 +1090,261 @@ game(int w, int h)
 int 
 main(int argc, char **argv)
 {
+  static const struct option longopts[] = {
+    { "threads",  required_argument, NULL, 't' },
+    { "procs",    required_argument, NULL, 'D' },
+    { "scaling",  no_argument,       NULL, 'S' },
+    { "hashlife", required_argument, NULL, 'H' },
+    { "hl-mem",   required_argument, NULL, 'M' },
+    { "tiles",    optional_argument, NULL, 'T' },
+    { "fps",      required_argument, NULL, 'F' },
+    { "every",    required_argument, NULL, 'E' },
+    { "bench",    required_argument, NULL, 'b' },
+    { "seed",     required_argument, NULL, 's' },
+    { "file",     required_argument, NULL, 'f' },
+    { "output",   required_argument, NULL, 'o' },
+    { "output-at", required_argument, NULL, 'O' },
+    { "stats",    required_argument, NULL, 'L' },
+    { "topology", required_argument, NULL, 'P' },
+    { "rule",     required_argument, NULL, 'r' },
+    { "cycle",    optional_argument, NULL, 'C' },
+    { "census",   required_argument, NULL, 'N' },
+    { "max-gens", required_argument, NULL, 'G' },
+    { "block",    optional_argument, NULL, 'B' },
+    { "block-gens", required_argument, NULL, 'K' },
+    { "packed",   no_argument,       NULL, 'p' },
+    { "kernel",   required_argument, NULL, 'k' },
+    { "pages",    no_argument,       NULL, 'Z' },
+    { "checkpoint", required_argument, NULL, 'c' },
+    { "checkpoint-every", required_argument, NULL, 'I' },
+    { "resume",   required_argument, NULL, 'R' },
+    { "jump",     required_argument, NULL, 'J' },
+    { NULL, 0, NULL, 0 }
+  };
   struct sigaction sa;
   memset(&sa, 0, sizeof(sa));
   sa.sa_handler = &handler;
   sigaction(SIGINT, &sa, NULL);
 
-  srand(time(NULL));
+  struct options o = { 0 };
+  int opt, seeded = 0, r = 0;
+  const char *resume = NULL;
 
-  int w = 0, h = 0;
+  o.kernel = grid_kernel_init(NULL);
 
-  if (argc > 1) w = atoi(argv[1]);
-  if (argc > 2) h = atoi(argv[2]);
-  if (w <= 0) w = 40;
-  if (h <= 0) h = 40;
-  game(w, h);
-  exit(EXIT_SUCCESS);
+  o.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  o.hashlife = -1;
+  o.hlmem = (size_t)256 << 20;
+  o.fps = 1e6 / SLEEPT;
+  o.every = 1;
+  o.max_gens = 100000;
+  o.block_gens = 8;
+  o.checkpoint_every = 60;
+  rule_life(&o.rule);
+  while ((opt = getopt_long(argc, argv, "t:H:b:f:o:r:", longopts, NULL)) != -1) {
+    switch (opt) {
+      case 't':
+        o.threads = atoi(optarg);
+        break;
+      case 'D':
+        o.procs = atoi(optarg);
+        if (o.procs <= 0) usage(argv[0]);
+        break;
+      case 'S':
+        o.scaling = 1;
+        break;
+      case 'H':
+        o.hashlife = atoi(optarg);
+        if (o.hashlife < 0) usage(argv[0]);
+        break;
+      case 'M':
+        o.hlmem = (size_t)atol(optarg) << 20;
+        break;
+      case 'T':
+        o.tiles = optarg ? atoi(optarg) : 64;
+        if (o.tiles <= 0) usage(argv[0]);
+        break;
+      case 'F':
+        o.fps = atof(optarg);
+        break;
+      case 'E':
+        o.every = atoi(optarg);
+        if (o.every <= 0) usage(argv[0]);
+        break;
+      case 'b':
+        o.bench = atol(optarg);
+        if (o.bench <= 0) usage(argv[0]);
+        break;
+      case 'J':
+        o.jump = strtoull(optarg, NULL, 0);
+        if (o.jump == 0) usage(argv[0]);
+        break;
+      case 's':
+        o.seed = strtoul(optarg, NULL, 0);
+        seeded = 1;
+        break;
+      case 'f':
+        if ((o.pattern = pattern_load(optarg)) == NULL) {
+          perror(optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'o':
+        o.output = optarg;
+        break;
+      case 'L':
+        o.stats = optarg;
+        break;
+      case 'O':
+        o.output_at = strtoull(optarg, NULL, 0);
+        break;
+      case 'P':
+        for (o.topology = 0; o.topology < 3; o.topology++)
+          if (strcmp(optarg, topologies[o.topology]) == 0)
+            break;
+        if (o.topology == 3) usage(argv[0]);
+        break;
+      case 'C':
+        o.cycle = optarg ? atoi(optarg) : 64;
+        if (o.cycle <= 0) usage(argv[0]);
+        break;
+      case 'Z':
+        o.pages = 1;
+        break;
+      case 'c':
+        o.checkpoint = optarg;
+        break;
+      case 'I':
+        o.checkpoint_every = atof(optarg);
+        if (o.checkpoint_every < 0) usage(argv[0]);
+        break;
+      case 'R':
+        resume = optarg;
+        break;
+      case 'B':
+        o.block = optarg ? atoi(optarg) : -1;
+        if (o.block == 0 || o.block < -1) usage(argv[0]);
+        break;
+      case 'K':
+        o.block_gens = atoi(optarg);
+        if (o.block_gens <= 0) usage(argv[0]);
+        break;
+      case 'p':
+        o.packed = 1;
+        break;
+      case 'k':
+        if ((o.kernel = grid_kernel_init(optarg)) == NULL) {
+          fprintf(stderr, "%s: no such kernel on this machine\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'N':
+        o.census = atol(optarg);
+        if (o.census <= 0) usage(argv[0]);
+        break;
+      case 'G':
+        o.max_gens = strtoull(optarg, NULL, 0);
+        break;
+      case 'r':
+        if (rule_parse(&o.rule, optarg) != 0) {
+          fprintf(stderr, "%s: not a B/S rule\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (o.threads <= 0) o.threads = 1;
+  if (resume != NULL) {
+    struct checkpoint_meta m;
+
+    /* the board, its size, rule and edges all come from the checkpoint */
+    if (optind < argc) usage(argv[0]);
+    if ((o.resumed = checkpoint_load(resume, &m)) == NULL) {
+      perror(resume);
+      exit(EXIT_FAILURE);
+    }
+    if (rule_parse(&o.rule, m.rule) != 0) {
+      fprintf(stderr, "%s: not a B/S rule\n", m.rule);
+      exit(EXIT_FAILURE);
+    }
+    o.resumed_gen = m.gen;
+    o.w = m.view_w;
+    o.h = m.view_h;
+    o.topology = m.topology;
+    if (o.checkpoint == NULL)
+      o.checkpoint = resume;
+  }
+  if ((o.checkpoint != NULL || resume != NULL)
+      && (o.census || o.scaling || o.hashlife >= 0)) {
+    /* Hashlife's universe reaches past the board, so it is not saved */
+    fprintf(stderr, "%s: checkpoints need a single grid or tiles run\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (!seeded) o.seed = o.bench || o.census || o.jump ? 1 : (unsigned)time(NULL);
+  /* with B0 empty space comes alive, so it cannot be skipped or grown */
+  if ((o.rule.birth & 1)
+      && (o.hashlife >= 0 || o.tiles > 0 || o.topology == BOARD_PLANE)) {
+    fprintf(stderr, "%s: B0 rules need a bounded board, no Hashlife or tiles\n",
+            o.rule.name);
+    exit(EXIT_FAILURE);
+  }
+  grid_rule_init(&o.rule);
+  if (o.block != 0 && o.topology == BOARD_PLANE) {
+    fprintf(stderr, "%s: blocks need a bounded board\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  /* gliders escaping a soup would grow its board until --max-gens */
+  if (o.census && o.topology == BOARD_PLANE) {
+    fprintf(stderr, "%s: a census needs a bounded board\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  if (optind < argc) o.w = atoi(argv[optind++]);
+  if (optind < argc) o.h = atoi(argv[optind++]);
+  if (o.w <= 0) o.w = o.pattern != NULL && o.pattern->w > 0 ? o.pattern->w : 40;
+  if (o.h <= 0) o.h = o.pattern != NULL && o.pattern->h > 0 ? o.pattern->h : 40;
+  if (o.block < 0)
+    o.block = block_size(o.block_gens);
+  /* one block is the whole board */
+  if (o.block > o.w && o.block > o.h)
+    o.block = o.w > o.h ? o.w : o.h;
+  if (o.procs > 0
+      && (o.hashlife >= 0 || o.tiles > 0 || o.block != 0 || o.cycle > 0
+          || o.topology == BOARD_PLANE || o.stats != NULL || o.pages
+          || o.checkpoint != NULL || o.census || o.scaling || o.procs > o.h)) {
+    fprintf(stderr, "%s: --procs plays a plain dead or torus grid, with at "
+            "most one process per row\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  /* evolve_packed() has dead edges and a thread, and no hash to watch */
+  if (o.packed
+      && (o.hashlife >= 0 || o.tiles > 0 || o.block != 0 || o.procs > 0
+          || o.topology != BOARD_DEAD || o.cycle > 0 || o.stats != NULL
+          || o.checkpoint != NULL || o.census || o.scaling || o.jump)) {
+    fprintf(stderr, "%s: --packed plays a plain dead grid on one thread\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (o.jump
+      && (o.bench || o.census || o.scaling || o.procs > 0 || o.hashlife >= 0
+          || o.tiles > 0 || o.block != 0 || o.cycle > 0 || o.stats != NULL)) {
+    fprintf(stderr, "%s: --jump picks its own engine and plays on its own\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (o.census)
+    census(&o);
+  else if (o.scaling)
+    r = scaling(&o);
+  else if (o.bench)
+    r = bench(&o);
+  else if (o.jump)
+    r = jump(&o);
+  else
+    r = game(&o);
+  packed_free(o.pattern);
+  exit(r == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
 } /* main */
@@ -0,0 +1,158 @@
+#!/bin/bash
+#
+# Runs every test of config.test through every engine, with each grid
+# kernel, and checks the population and checksum each ends with against
+# <test>.out.  With -p,
+# benchmarks the engines on soup instead, and fails if any is slower
+# than in perf.base by more than PERF_SLACK percent; with -s as well,
+# saves the results as perf.base.
+#
+#   usage: run_tests.sh [-p [-s]] [life]
+#
+
+source ./config.test;
+
+PERF=;
+SAVE=;
+while getopts "ps" opt; do
+	case $opt in
+	p) PERF=1;;
+	s) SAVE=1;;
+	*) echo "usage: $0 [-p [-s]] [life]"; exit 1;;
+	esac;
+done;
+shift $((OPTIND - 1));
+
+BIN=`cd .. && pwd`/life;
+if [[ "$#" -eq 1 ]]; then
+	BIN=`cd $(dirname $1) && pwd`/`basename $1`;
+fi;
+if [[ ! -x ${BIN} ]]; then
+	echo "error: no ${BIN}, run make first";
+	exit 1;
+fi;
+
+TC_DIR=`pwd`;
+TMP=`mktemp -d /tmp/life.tests.XXXXXX`;
+
+function cleanUp()
+{
+	rm -Rf ${TMP};
+}
+
+# frames <gens> <engine>: the arguments to reach gens on engine, last
+function frames()
+{
+	local gens=$1 k;
+
+	case $2 in
+	block)
+		for k in 8 4 2 1; do
+			[[ $((gens % k)) -eq 0 ]] && break;
+		done;
+		echo "--block-gens $k -b $((gens / k))";;
+	hashlife)
+		for k in 3 2 1 0; do
+			[[ $((gens % (1 << k))) -eq 0 ]] && break;
+		done;
+		echo "-H $k -b $((gens >> k))";;
+	jump)
+		echo "--jump $gens";;
+	*)
+		echo "-b $gens";;
+	esac;
+}
+
+# kernels: those of KERNELS that life has here
+function kernels()
+{
+	local k;
+
+	for k in ${KERNELS}; do
+		${BIN} --kernel $k -b 1 8 8 >/dev/null 2>&1 && printf "%s " $k;
+	done;
+}
+
+cp ${TC_DIR}/*.rle ${TMP} && cd ${TMP} || { cleanUp; exit 1; }
+
+if [[ -n ${PERF} ]]; then
+	echo "RUN BENCHMARKS";
+	printf "%-6s %-8s %12s %12s %12s\n" size engine gens/sec cells/sec baseline;
+	SLOWER=0;
+	: > perf.out;
+	for size in ${PERF_SIZES}; do
+		GENS=PERF_GENS_${size};
+		for engine in ${PERF_ENGINES}; do
+			OPTS=ENGINE_${engine};
+			${BIN} ${!OPTS} $(frames ${!GENS} ${engine}) --seed 1 ${size} ${size} \
+				> ${engine}.bench 2>&1;
+			RATE=`awk '/^gens\/sec/ { print $2 }' ${engine}.bench`;
+			CELLS=`awk '/^cells\/sec/ { print $2 }' ${engine}.bench`;
+			if [[ -z ${CELLS} ]]; then
+				echo "${size} ${engine}: FAILED";
+				cat ${engine}.bench;
+				((SLOWER++));
+				continue;
+			fi;
+			echo "${size} ${engine} ${CELLS}" >> perf.out;
+			BASE=`awk -v s=${size} -v e=${engine} '$1 == s && $2 == e { print $3 }' \
+				${TC_DIR}/perf.base 2>/dev/null`;
+			VERDICT=;
+			if [[ -n ${BASE} ]]; then
+				VERDICT=`awk -v c=${CELLS} -v b=${BASE} -v s=${PERF_SLACK} \
+					'BEGIN { d = (c / b - 1) * 100;
+					         printf "%+.0f%%%s", d, d < -s ? " SLOWER" : "" }'`;
+				[[ ${VERDICT} == *SLOWER ]] && ((SLOWER++));
+			fi;
+			printf "%-6s %-8s %12s %12s %12s %s\n" ${size} ${engine} ${RATE} ${CELLS} \
+				"${BASE:--}" "${VERDICT}";
+		done;
+	done;
+	if [[ -n ${SAVE} ]]; then
+		cp perf.out ${TC_DIR}/perf.base;
+		echo "saved as the baseline";
+	fi;
+	cleanUp;
+	[[ ${SLOWER} -eq 0 ]];
+	exit;
+fi;
+
+echo "RUN REGRESSION TESTS";
+PASSED=0;
+FAILED=0;
+HAVE=`kernels`;
+for kernel in ${KERNELS}; do
+	if [[ " ${HAVE}" != *" ${kernel} "* ]]; then
+		echo "${kernel}: not on this machine, skipped";
+	fi;
+done;
+for kernel in ${HAVE}; do
+	for tc in ${TESTS}; do
+		read GENS ARGS < ${TC_DIR}/${tc}.arg;
+		SKIP=SKIP_${tc};
+		for engine in ${ENGINES}; do
+			if [[ " ${!SKIP} " == *" ${engine} "* ]]; then
+				continue;
+			fi;
+			OPTS=ENGINE_${engine};
+			CMD="${BIN} --kernel ${kernel} ${!OPTS} $(frames ${GENS} ${engine}) ${ARGS}";
+			OUT=${tc}.${engine}.${kernel};
+			${CMD} 2>&1 | grep -E '^(population|checksum)' > ${OUT};
+			if diff ${TC_DIR}/${tc}.out ${OUT} >/dev/null; then
+				echo "${tc} ${engine} ${kernel}: PASS";
+				((PASSED++));
+			else
+				echo "${tc} ${engine} ${kernel}: FAILED";
+				echo "  ${CMD}";
+				diff --side-by-side -W 80 ${TC_DIR}/${tc}.out ${OUT};
+				((FAILED++));
+			fi;
+		done;
+	done;
+done;
+
+echo;
+echo "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=";
+echo "${PASSED} passed, ${FAILED} failed";
+cleanUp;
+[[ ${FAILED} -eq 0 ]];
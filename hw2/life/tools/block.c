@@ -0,0 +1,241 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         block.c
+* Description:  Cache-blocked evolution, several generations per pass
+*
+*******************************************************************************
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "grid.h"
+#include "block.h"
+
+#define L2_DEFAULT (256 << 10)  /* if the system will not tell */
+
+/*
+ * Blocked passes of one block size and depth, with two scratch grids
+ * of side size + 2 gens for each thread, kept from pass to pass
+ *
+ */
+struct block {
+  int size, gens;
+  int side, stride;             /* of the scratch grids */
+  int threads;
+  unsigned char **scratch;      /* two a thread */
+};
+
+/*
+ * One pass of block_step, shared by the threads of the pool
+ *
+ */
+struct pass {
+  struct block *bk;
+  struct board *b;
+  int nx;                       /* blocks across */
+  int next;                     /* scratch handed out so far */
+};
+
+/*
+ * block_size:
+ *  A block side for gens generations a pass such that the two scratch
+ *  grids, halo included, take about half of the L2 cache, and are a
+ *  whole number of cache lines across.
+ *
+ */
+int
+block_size(int gens)
+{
+  long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  int side, size;
+
+  if (l2 <= 0)
+    l2 = L2_DEFAULT;
+  side = (int)sqrt(l2 / 4.0);
+  size = (side & ~63) - 2 * gens;
+  return size >= 64 ? size : 64;
+} /* block_size */
+
+/*
+ * fetch:
+ *  Copies n cells of row y of b from column x on to dst, wrapping
+ *  around on a torus and reading dead cells past a dead edge
+ *
+ */
+static void
+fetch(const struct board *b, int x, int y, int n, unsigned char *dst)
+{
+  int k;
+  const unsigned char *g = BOARD_CUR(b);
+
+  if (b->topology == BOARD_TORUS) {
+    y = ((y % b->h) + b->h) % b->h;
+    while (n > 0) {
+      x = ((x % b->w) + b->w) % b->w;
+      k = b->w - x < n ? b->w - x : n;
+      memcpy(dst, g + y * b->stride + x, k);
+      dst += k;
+      x += k;
+      n -= k;
+    }
+    return;
+  }
+  memset(dst, 0, n);
+  if (y < 0 || y >= b->h)
+    return;
+  k = x < 0 ? -x : 0;
+  if (x + n > b->w)
+    n = b->w - x;
+  if (n > k)
+    memcpy(dst + k, g + y * b->stride + x + k, n - k);
+} /* fetch */
+
+/*
+ * advance:
+ *  Advances the block at (x0, y0), cols by rows cells, gens
+ *  generations in the scratch grids s[0] and s[1] and writes it to
+ *  the next generation of b
+ *
+ */
+static void
+advance(const struct block *bk, struct board *b, unsigned char **s,
+        int x0, int y0, int cols, int rows)
+{
+  int k = bk->gens, stride = bk->stride, i, y, lo_x, hi_x, lo_y, hi_y;
+  int cur = 0, dead = b->topology != BOARD_TORUS;
+
+  /* s[1] is read past a dead edge and must be dead there */
+  if (dead && (x0 < k || y0 < k || x0 + cols + k > b->w
+               || y0 + rows + k > b->h))
+    for (y = 0; y < rows + 2 * k; y++)
+      memset(s[1] + y * stride, 0, cols + 2 * k);
+  for (y = 0; y < rows + 2 * k; y++)
+    fetch(b, x0 - k, y0 - k + y, cols + 2 * k, s[0] + y * stride);
+  for (i = 1; i <= k; i++) {
+    /*
+     * The halo shrinks a cell a generation, and past a dead edge stays
+     * dead.  Whole rows are still computed, ghosts and stale cells at
+     * their ends only spoiling halo that is no longer needed, so that
+     * the kernel keeps to whole vectors.
+     */
+    lo_x = 0;
+    hi_x = bk->side;
+    lo_y = i;
+    hi_y = rows + 2 * k - i;
+    if (dead) {
+      lo_x = lo_x > k - x0 ? lo_x : k - x0;
+      hi_x = hi_x < b->w - x0 + k ? hi_x : b->w - x0 + k;
+      lo_y = lo_y > k - y0 ? lo_y : k - y0;
+      hi_y = hi_y < b->h - y0 + k ? hi_y : b->h - y0 + k;
+    }
+    evolve_grid_rows(s[cur] + lo_x, s[cur ^ 1] + lo_x, hi_x - lo_x, stride,
+                     lo_y, hi_y);
+    cur ^= 1;
+  }
+  for (y = 0; y < rows; y++)
+    memcpy(BOARD_NEXT(b) + (y0 + y) * b->stride + x0,
+           s[cur] + (k + y) * stride + k, cols);
+} /* advance */
+
+/*
+ * pass_rows:
+ *  Runs the blocks of block rows [j0, j1) in scratch of its own
+ *
+ */
+static void
+pass_rows(void *arg, int j0, int j1)
+{
+  struct pass *ps = arg;
+  struct block *bk = ps->bk;
+  struct board *b = ps->b;
+  int i, j, x0, y0, size = bk->size;
+  unsigned char **s = bk->scratch + 2 * __atomic_fetch_add(&ps->next, 1,
+                                                           __ATOMIC_RELAXED);
+
+  for (j = j0; j < j1; j++)
+    for (i = 0; i < ps->nx; i++) {
+      x0 = i * size;
+      y0 = j * size;
+      advance(bk, b, s, x0, y0, b->w - x0 < size ? b->w - x0 : size,
+              b->h - y0 < size ? b->h - y0 : size);
+    }
+} /* pass_rows */
+
+/*
+ * block_new:
+ *  Blocked passes of gens generations over size-by-size blocks by up
+ *  to threads threads; NULL if out of memory
+ *
+ */
+struct block *
+block_new(int size, int gens, int threads)
+{
+  int i;
+  struct block *bk = calloc(1, sizeof(*bk));
+
+  if (bk == NULL)
+    return NULL;
+  bk->size = size;
+  bk->gens = gens;
+  bk->side = size + 2 * gens;
+  bk->threads = threads;
+  if ((bk->scratch = calloc(2 * threads, sizeof(*bk->scratch))) == NULL) {
+    free(bk);
+    return NULL;
+  }
+  for (i = 0; i < 2 * threads; i++)
+    if ((bk->scratch[i] = grid_new(bk->side, bk->side, &bk->stride)) == NULL) {
+      block_free(bk);
+      return NULL;
+    }
+  return bk;
+} /* block_new */
+
+/*
+ * block_free:
+ *  Releases bk and its scratch
+ *
+ */
+void
+block_free(struct block *bk)
+{
+  int i;
+
+  if (bk == NULL)
+    return;
+  for (i = 0; i < 2 * bk->threads; i++)
+    grid_free(bk->scratch[i], bk->stride);
+  free(bk->scratch);
+  free(bk);
+} /* block_free */
+
+/*
+ * block_step:
+ *  Advances b by bk->gens generations in one blocked pass, on the
+ *  threads of p if it is not NULL, of which there must be no more than
+ *  bk was made for.  A torus smaller than the halo falls back to single
+ *  steps.
+ *
+ */
+int
+block_step(struct block *bk, struct board *b, struct pool *p)
+{
+  int i, ny = (b->h + bk->size - 1) / bk->size;
+  struct pass ps = { bk, b, (b->w + bk->size - 1) / bk->size, 0 };
+
+  if (b->topology == BOARD_TORUS && (bk->gens > b->w || bk->gens > b->h)) {
+    for (i = 0; i < bk->gens; i++)
+      if (board_step(b, p) != 0)
+        return -1;
+    return 0;
+  }
+  if (p != NULL)
+    pool_run(p, pass_rows, &ps, ny);
+  else
+    pass_rows(&ps, 0, ny);
+  board_swap(b);
+  return 0;
+} /* block_step */
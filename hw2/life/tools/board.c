@@ -0,0 +1,295 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         board.c
+* Description:  Double-buffered board of a running game
+*
+*******************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "board.h"
+
+#define GROW_MIN 64             /* fewest cells a plane grows by */
+#define HASH_ROWS 16            /* rows evolved before they are hashed */
+
+/*
+ * board_new:
+ *  Allocates an all-dead w-by-h board with dead edges; NULL if out of
+ *  memory
+ *
+ */
+struct board *
+board_new(int w, int h)
+{
+  struct board *b = calloc(1, sizeof(*b));
+
+  if (b == NULL)
+    return NULL;
+  b->w = w;
+  b->h = h;
+  if (grid_new_n(w, h, 2, b->grid, &b->stride) != 0) {
+    free(b);
+    return NULL;
+  }
+  return b;
+} /* board_new */
+
+void
+board_free(struct board *b)
+{
+  if (b == NULL)
+    return;
+  /* both generations are one block, released through the first */
+  grid_free(b->grid[0], b->stride);
+  grid_hash_free(&b->hash);
+  free(b);
+} /* board_free */
+
+/*
+ * touch_rows:
+ *  Clears rows [y0, y1) of both generations, with the border rows
+ *  beyond the first and last
+ *
+ */
+static void
+touch_rows(void *arg, int y0, int y1)
+{
+  struct board *b = arg;
+  int i;
+
+  if (y0 == 0)
+    y0 = -1;
+  if (y1 == b->h)
+    y1 = b->h + 1;
+  for (i = 0; i < 2; i++)
+    memset(b->grid[i] + y0 * b->stride - 1, 0, (size_t)(y1 - y0) * b->stride);
+} /* touch_rows */
+
+/*
+ * board_touch:
+ *  Writes a new board for the first time from the threads of p, each
+ *  the band of rows it will evolve, so that on a NUMA machine every
+ *  band lives on the node of the thread that works on it
+ *
+ */
+void
+board_touch(struct board *b, struct pool *p)
+{
+  if (p != NULL)
+    pool_run(p, touch_rows, b, b->h);
+  else
+    touch_rows(b, 0, b->h);
+} /* board_touch */
+
+/*
+ * board_swap:
+ *  Makes the next generation the current one
+ *
+ */
+void
+board_swap(struct board *b)
+{
+  b->cur ^= 1;
+} /* board_swap */
+
+/*
+ * edges:
+ *  Which edges of the current generation have live cells on them, as
+ *  a mask of 1 top, 2 bottom, 4 left and 8 right
+ *
+ */
+static int
+edges(const struct board *b)
+{
+  int y, mask = 0;
+  const unsigned char *g = BOARD_CUR(b);
+
+  if (memchr(g, 1, b->w) != NULL)
+    mask |= 1;
+  if (memchr(g + (b->h - 1) * b->stride, 1, b->w) != NULL)
+    mask |= 2;
+  for (y = 0; y < b->h && (mask & 12) != 12; y++) {
+    mask |= g[y * b->stride] ? 4 : 0;
+    mask |= g[y * b->stride + b->w - 1] ? 8 : 0;
+  }
+  return mask;
+} /* edges */
+
+/*
+ * board_grow:
+ *  Adds dead cells around the board: left, top, right and bottom of
+ *  them past each edge, left rounded up to whole words of the position
+ *  hash so that the hash stays the same.  What is on the board keeps
+ *  its place on the plane, ox and oy moving with it.  Returns -1 if out
+ *  of memory, leaving b as it was.
+ *
+ */
+int
+board_grow(struct board *b, int left, int top, int right, int bottom)
+{
+  int y, stride, w, h;
+  unsigned char *grid[2];
+
+  left = (left + 63) & ~63;
+  w = b->w + left + right;
+  h = b->h + top + bottom;
+  if (grid_new_n(w, h, 2, grid, &stride) != 0)
+    return -1;
+  for (y = 0; y < b->h; y++)
+    memcpy(grid[0] + (y + top) * stride + left,
+           BOARD_CUR(b) + y * b->stride, b->w);
+  grid_free(b->grid[0], b->stride);
+  b->grid[0] = grid[0];
+  b->grid[1] = grid[1];
+  b->cur = 0;
+  b->w = w;
+  b->h = h;
+  b->stride = stride;
+  b->ox += left;
+  b->oy += top;
+  return b->hashing ? board_hash_start(b) : 0;
+} /* board_grow */
+
+/*
+ * grow:
+ *  Enlarges the board past every edge that has live cells on it, by
+ *  half its size or GROW_MIN cells, whichever is more, so the cost of
+ *  growing stays small next to the generations between two growths
+ *
+ */
+static int
+grow(struct board *b, int mask)
+{
+  int mx = b->w / 2 > GROW_MIN ? (b->w / 2 + 63) & ~63 : GROW_MIN;
+  int my = b->h / 2 > GROW_MIN ? b->h / 2 : GROW_MIN;
+
+  return board_grow(b, mask & 4 ? mx : 0, mask & 1 ? my : 0,
+                    mask & 8 ? mx : 0, mask & 2 ? my : 0);
+} /* grow */
+
+/*
+ * board_prepare:
+ *  Makes the ghost cells of the current generation what the topology
+ *  says lies beyond the edges.  On a plane the board may grow, which
+ *  fails with -1 if out of memory.
+ *
+ */
+int
+board_prepare(struct board *b)
+{
+  int mask;
+
+  if (b->topology == BOARD_TORUS)
+    grid_wrap(BOARD_CUR(b), b->w, b->h, b->stride);
+  else if (b->topology == BOARD_PLANE && (mask = edges(b)) != 0)
+    return grow(b, mask);
+  return 0;
+} /* board_prepare */
+
+/*
+ * board_hash_start:
+ *  Hashes the current generation and keeps the hash up to date from
+ *  now on; -1 if out of memory
+ *
+ */
+int
+board_hash_start(struct board *b)
+{
+  b->hashing = grid_hash_init(&b->hash, BOARD_CUR(b), b->w, b->h, b->stride,
+                              -b->ox, -b->oy) == 0;
+  return b->hashing ? 0 : -1;
+} /* board_hash_start */
+
+/*
+ * hashed_rows:
+ *  Evolves rows [y0, y1) and rehashes the words that changed, a few
+ *  rows at a time so that they are still in cache.  The kernel packs
+ *  the rows as it writes them, so the cells are read once.
+ *
+ */
+static void
+hashed_rows(void *arg, int y0, int y1)
+{
+  struct board *b = arg;
+  int y, end;
+  uint64_t sum = 0;
+
+  for (y = y0; y < y1; y = end) {
+    end = y + HASH_ROWS < y1 ? y + HASH_ROWS : y1;
+    evolve_grid_packed(BOARD_CUR(b), BOARD_NEXT(b), b->w, b->stride, y, end,
+                       b->hash.next);
+    sum += grid_hash_next(&b->hash, y, end);
+  }
+  __atomic_fetch_add(&b->hash.sum, sum, __ATOMIC_RELAXED);
+} /* hashed_rows */
+
+/*
+ * board_step:
+ *  Advances b by one generation, on the threads of p if it is not
+ *  NULL; -1 if a plane could not grow.  While hashing, the hash is
+ *  brought up to date every hash_every steps; in between it stays as
+ *  it was, and the step costs what it would without.
+ *
+ */
+int
+board_step(struct board *b, struct pool *p)
+{
+  int hash = b->hashing && b->hash_wait-- <= 1;
+
+  if (board_prepare(b) != 0)
+    return -1;
+  if (hash)
+    b->hash_wait = b->hash_every;
+  if (hash && p != NULL)
+    pool_run(p, hashed_rows, b, b->h);
+  else if (hash)
+    hashed_rows(b, 0, b->h);
+  else if (p != NULL)
+    pool_evolve(p, BOARD_CUR(b), BOARD_NEXT(b), b->w, b->h, b->stride);
+  else
+    evolve_grid(BOARD_CUR(b), BOARD_NEXT(b), b->w, b->h, b->stride);
+  board_swap(b);
+  return 0;
+} /* board_step */
+
+/*
+ * board_period:
+ *  Steps b on until its cells are back to what they are now, for at
+ *  most n generations: a hash met again only says they might be.
+ *  Returns the generations that took, 0 if they did not come back (b
+ *  is then n generations on), or -1 if out of memory or a plane could
+ *  not grow.
+ *
+ */
+long long
+board_period(struct board *b, struct pool *p, unsigned long long n)
+{
+  int y, w = b->w, h = b->h, ox = b->ox, oy = b->oy;
+  unsigned char *was = malloc((size_t)w * h);
+  unsigned long long k;
+  long long r = 0;
+
+  if (was == NULL)
+    return -1;
+  for (y = 0; y < h; y++)
+    memcpy(was + (size_t)y * w, BOARD_CUR(b) + y * b->stride, w);
+  for (k = 1; k <= n && r == 0; k++) {
+    if (board_step(b, p) != 0) {
+      r = -1;
+      break;
+    }
+    /* a plane that grew is no longer what it was */
+    if (b->w != w || b->h != h || b->ox != ox || b->oy != oy)
+      continue;
+    for (y = 0; y < h; y++)
+      if (memcmp(was + (size_t)y * w, BOARD_CUR(b) + y * b->stride, w) != 0)
+        break;
+    if (y == h)
+      r = k;
+  }
+  free(was);
+  return r;
+} /* board_period */
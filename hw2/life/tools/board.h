@@ -0,0 +1,51 @@
+#ifndef __BOARD_H
+#define __BOARD_H
+#include "grid.h"
+#include "pool.h"
+
+/*
+ * What lies beyond the edges of a board: dead cells, the opposite
+ * edge (a torus), or more of an unbounded plane, which the board grows
+ * into as the pattern reaches its edges.
+ *
+ */
+#define BOARD_DEAD  0
+#define BOARD_TORUS 1
+#define BOARD_PLANE 2
+
+/*
+ * A board owns the two grids of a running game: the current
+ * generation and the one being computed.  Stepping writes the next
+ * generation and swaps the two pointers; nothing is ever copied.
+ * The topology is applied to the ghost cells around the grids before
+ * each generation, so the kernels never check bounds.
+ *
+ */
+struct board {
+  int w, h, stride;
+  int cur;                      /* index of the current generation */
+  unsigned char *grid[2];       /* one block, freed through grid[0] */
+  int topology;
+  int ox, oy;                   /* where the board started, after growth */
+  int hashing;                  /* keep hash up to date while stepping */
+  int hash_every;               /* ... every this many steps, 0 for each */
+  int hash_wait;                /* steps until it next is */
+  struct grid_hash hash;        /* of the current generation */
+};
+
+#define BOARD_CUR(b)  ((b)->grid[(b)->cur])
+#define BOARD_NEXT(b) ((b)->grid[(b)->cur ^ 1])
+#define BOARD_VIEW(b) (BOARD_CUR(b) + (b)->oy * (b)->stride + (b)->ox)
+/* hash is of the current generation, as board_step last left it */
+#define BOARD_HASHED(b) ((b)->hashing && (b)->hash_wait == (b)->hash_every)
+
+struct board *board_new(int w, int h);
+void board_free(struct board *b);
+void board_touch(struct board *b, struct pool *p);
+void board_swap(struct board *b);
+int board_grow(struct board *b, int left, int top, int right, int bottom);
+int board_prepare(struct board *b);
+int board_hash_start(struct board *b);
+int board_step(struct board *b, struct pool *p);
+long long board_period(struct board *b, struct pool *p, unsigned long long n);
+#endif
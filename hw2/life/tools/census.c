@@ -0,0 +1,420 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         census.c
+* Description:  Census of the objects left on settled boards
+*
+*******************************************************************************
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "census.h"
+
+#define MARGIN  8               /* room around an object evolved alone */
+#define BUCKETS 4096
+
+/*
+ * One kind of object: its canonical form is the smallest, as a
+ * string, of its eight orientations in all of its phases, each
+ * written "WxH:" and then its rows of '.' and 'o' joined by '/'.
+ *
+ */
+struct entry {
+  struct entry *next;
+  char *key;
+  unsigned long long period;    /* 0 if it did not repeat when alone, */
+                                /* as when held up by a dead edge */
+  int cells;                    /* in the phase the key was taken from */
+  unsigned long long count;
+};
+
+struct census {
+  pthread_mutex_t lock;
+  struct entry *buckets[BUCKETS];
+  unsigned long long objects;
+};
+
+/*
+ * The usual ash of a B3/S23 soup, by canonical form
+ *
+ */
+static const struct {
+  const char *key, *name;
+} names[] = {
+  { "2x2:oo/oo", "block" },
+  { "1x3:o/o/o", "blinker" },
+  { "3x4:.o./o.o/o.o/.o.", "beehive" },
+  { "3x3:.o./o.o/.o.", "tub" },
+  { "3x3:.o./o.o/.oo", "boat" },
+  { "3x3:.oo/o.o/oo.", "ship" },
+  { "4x4:..o./.o.o/o..o/.oo.", "loaf" },
+  { "4x4:.oo./o..o/o..o/.oo.", "pond" },
+  { "4x4:..o./.o.o/o.o./oo..", "long boat" },
+  { "4x4:..o./.o.o/o.o./.o..", "barge" },
+  { "2x4:.o/oo/oo/o.", "toad" },
+  { "4x4:..oo/...o/o.../oo..", "beacon" },
+  { "4x4:...o/.ooo/o.../oo..", "eater" },
+  { "4x5:..o./.o.o/o..o/o.o./.o..", "mango" },
+  { "3x4:.oo/..o/o../oo.", "aircraft carrier" },
+  { "2x4:oo/.o/o./oo", "snake" },
+  { "4x4:..oo/.o.o/o.o./oo..", "long ship" },
+  { "5x5:...oo/....o/.ooo./o..../oo...", "integral" },
+};
+
+/*
+ * orient:
+ *  Writes the key of the w-by-h bitmap g turned by t: bit 0 mirrors
+ *  x, bit 1 mirrors y, bit 2 swaps x and y
+ *
+ */
+static void
+orient(const unsigned char *g, int w, int h, int t, char *key)
+{
+  int x, y, sx, sy, tw = t & 4 ? h : w, th = t & 4 ? w : h;
+
+  key += sprintf(key, "%dx%d:", tw, th);
+  for (y = 0; y < th; y++) {
+    for (x = 0; x < tw; x++) {
+      sx = t & 4 ? y : x;
+      sy = t & 4 ? x : y;
+      if (t & 1)
+        sx = w - 1 - sx;
+      if (t & 2)
+        sy = h - 1 - sy;
+      *key++ = g[sy * w + sx] ? 'o' : '.';
+    }
+    *key++ = y + 1 < th ? '/' : '\0';
+  }
+} /* orient */
+
+/*
+ * canonical:
+ *  Writes into key the smallest key of the live cells of board b, in
+ *  any orientation.  key has room for (w + 1) * h + 24 characters.
+ *
+ */
+static void
+canonical(const struct board *b, char *key, char *tmp, unsigned char *bits)
+{
+  int x, y, t, x0 = b->w, y0 = b->h, x1 = -1, y1 = -1, w, h;
+  const unsigned char *g = BOARD_CUR(b);
+
+  for (y = 0; y < b->h; y++)
+    for (x = 0; x < b->w; x++)
+      if (g[y * b->stride + x]) {
+        x0 = x < x0 ? x : x0;
+        x1 = x > x1 ? x : x1;
+        y0 = y < y0 ? y : y0;
+        y1 = y > y1 ? y : y1;
+      }
+  if (x1 < 0) {
+    strcpy(key, "0x0:");
+    return;
+  }
+  w = x1 - x0 + 1;
+  h = y1 - y0 + 1;
+  for (y = 0; y < h; y++)
+    memcpy(bits + y * w, g + (y + y0) * b->stride + x0, w);
+  orient(bits, w, h, 0, key);
+  for (t = 1; t < 8; t++) {
+    orient(bits, w, h, t, tmp);
+    if (strcmp(tmp, key) < 0)
+      strcpy(key, tmp);
+  }
+} /* canonical */
+
+/*
+ * classify:
+ *  Evolves the object alone on b, which holds nothing else, for up
+ *  to period generations to find its own period, 0 if it does not
+ *  repeat, and the key of its smallest phase.  The board is left in
+ *  an unknown state.  -1 if out of memory or b could not be stepped.
+ *
+ */
+static int
+classify(struct board *b, unsigned long long period, char *key,
+         unsigned long long *own, int *cells)
+{
+  unsigned long long q;
+  int y, rc = -1;
+  size_t size = (size_t)(b->w + 1) * b->h + 24;
+  char *phase = malloc(size), *best = malloc(size), *tmp = malloc(size);
+  unsigned char *bits = malloc((size_t)b->w * b->h);
+  unsigned char *start = malloc((size_t)b->w * b->h);
+
+  if (phase == NULL || best == NULL || tmp == NULL || bits == NULL
+      || start == NULL)
+    goto out;
+  for (y = 0; y < b->h; y++)
+    memcpy(start + y * b->w, BOARD_CUR(b) + y * b->stride, b->w);
+  canonical(b, key, tmp, bits);
+  strcpy(best, key);
+  *own = 0;
+  for (q = 1; q <= period; q++) {
+    if (board_step(b, NULL) != 0)
+      goto out;
+    for (y = 0; y < b->h; y++)
+      if (memcmp(start + y * b->w, BOARD_CUR(b) + y * b->stride, b->w) != 0)
+        break;
+    if (y == b->h) {
+      *own = q;
+      break;
+    }
+    canonical(b, phase, tmp, bits);
+    if (strcmp(phase, best) < 0)
+      strcpy(best, phase);
+  }
+  /* an object that does not repeat alone is kept as it was found */
+  if (*own != 0)
+    strcpy(key, best);
+  *cells = 0;
+  for (y = 0; y < b->w * b->h; y++)
+    *cells += start[y];
+  rc = 0;
+
+out:
+  free(phase);
+  free(best);
+  free(tmp);
+  free(bits);
+  free(start);
+  return rc;
+} /* classify */
+
+static uint32_t
+hash(const char *s)
+{
+  uint32_t h = 2166136261u;
+
+  while (*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return h;
+} /* hash */
+
+/*
+ * count:
+ *  Adds one object of kind key; -1 if out of memory
+ *
+ */
+static int
+count(struct census *c, const char *key, unsigned long long period, int cells)
+{
+  struct entry **slot = &c->buckets[hash(key) % BUCKETS], *e;
+  int rc = 0;
+
+  pthread_mutex_lock(&c->lock);
+  for (e = *slot; e != NULL && strcmp(e->key, key) != 0; e = e->next)
+    ;
+  if (e == NULL && (e = calloc(1, sizeof(*e))) != NULL) {
+    if ((e->key = strdup(key)) == NULL) {
+      free(e);
+      e = NULL;
+    } else {
+      e->period = period;
+      e->cells = cells;
+      e->next = *slot;
+      *slot = e;
+    }
+  }
+  if (e != NULL) {
+    e->count++;
+    c->objects++;
+  } else {
+    rc = -1;
+  }
+  pthread_mutex_unlock(&c->lock);
+  return rc;
+} /* count */
+
+struct census *
+census_new(void)
+{
+  struct census *c = calloc(1, sizeof(*c));
+
+  if (c != NULL)
+    pthread_mutex_init(&c->lock, NULL);
+  return c;
+} /* census_new */
+
+void
+census_free(struct census *c)
+{
+  int i;
+  struct entry *e;
+
+  if (c == NULL)
+    return;
+  for (i = 0; i < BUCKETS; i++)
+    while ((e = c->buckets[i]) != NULL) {
+      c->buckets[i] = e->next;
+      free(e->key);
+      free(e);
+    }
+  pthread_mutex_destroy(&c->lock);
+  free(c);
+} /* census_free */
+
+/*
+ * census_add:
+ *  Counts the objects of the current generation of b, which repeats
+ *  every period generations.  Live cells that touch, diagonals
+ *  included, make one object; on a torus they touch across the edges
+ *  too.  -1 if out of memory, or an object could not be evolved.
+ *
+ */
+int
+census_add(struct census *c, const struct board *b, unsigned long long period)
+{
+  int i, x, y, n, top, x0, y0, x1, y1, rc = -1, cells;
+  int torus = b->topology == BOARD_TORUS;
+  size_t size = (size_t)b->w * b->h;
+  const unsigned char *g = BOARD_CUR(b);
+  unsigned char *seen = calloc(size, 1);
+  /* cells as found, unwrapped on a torus: x, y pairs */
+  int *stack = malloc(2 * size * sizeof(int));
+  int *group = malloc(2 * size * sizeof(int));
+  struct board *alone = NULL;
+  char *key = NULL;
+  unsigned long long own;
+
+  if (seen == NULL || stack == NULL || group == NULL)
+    goto out;
+  for (i = 0; i < (int)size; i++) {
+    if (seen[i] || !g[(i / b->w) * b->stride + i % b->w])
+      continue;
+    /* flood the object from cell i */
+    n = 0;
+    top = 0;
+    stack[top++] = x0 = x1 = i % b->w;
+    stack[top++] = y0 = y1 = i / b->w;
+    seen[i] = 1;
+    while (top > 0) {
+      int ky = stack[--top], kx = stack[--top], dx, dy, wx, wy;
+
+      group[n++] = kx;
+      group[n++] = ky;
+      x0 = kx < x0 ? kx : x0;
+      x1 = kx > x1 ? kx : x1;
+      y0 = ky < y0 ? ky : y0;
+      y1 = ky > y1 ? ky : y1;
+      for (dy = -1; dy <= 1; dy++)
+        for (dx = -1; dx <= 1; dx++) {
+          x = kx + dx;
+          y = ky + dy;
+          wx = torus ? ((x % b->w) + b->w) % b->w : x;
+          wy = torus ? ((y % b->h) + b->h) % b->h : y;
+          if (wx < 0 || wy < 0 || wx >= b->w || wy >= b->h
+              || seen[wy * b->w + wx] || !g[wy * b->stride + wx])
+            continue;
+          seen[wy * b->w + wx] = 1;
+          stack[top++] = x;
+          stack[top++] = y;
+        }
+    }
+
+    /* evolve it alone to get its own period and smallest phase */
+    alone = board_new(x1 - x0 + 1 + 2 * MARGIN, y1 - y0 + 1 + 2 * MARGIN);
+    key = alone ? malloc((size_t)(alone->w + 1) * alone->h + 24) : NULL;
+    if (key == NULL)
+      goto out;
+    for (; n > 0; n -= 2)
+      BOARD_CUR(alone)[(group[n - 1] - y0 + MARGIN) * alone->stride
+                       + group[n - 2] - x0 + MARGIN] = 1;
+    if (classify(alone, period, key, &own, &cells) != 0
+        || count(c, key, own, cells) != 0)
+      goto out;
+    board_free(alone);
+    free(key);
+    alone = NULL;
+    key = NULL;
+  }
+  rc = 0;
+
+out:
+  board_free(alone);
+  free(key);
+  free(seen);
+  free(stack);
+  free(group);
+  return rc;
+} /* census_add */
+
+static int
+by_count(const void *a, const void *b)
+{
+  const struct entry *x = *(const struct entry **)a;
+  const struct entry *y = *(const struct entry **)b;
+
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return strcmp(x->key, y->key);
+} /* by_count */
+
+/*
+ * rle:
+ *  Writes the rows of a key in RLE, without the header
+ *
+ */
+static void
+rle(const char *key, FILE *f)
+{
+  const char *p = strchr(key, ':') + 1;
+  int n;
+
+  while (*p) {
+    for (n = 1; p[n] == p[0]; n++)
+      ;
+    if (n > 1)
+      fprintf(f, "%d", n);
+    fputc(*p == '/' ? '$' : *p == 'o' ? 'o' : 'b', f);
+    p += n;
+  }
+  fputc('!', f);
+} /* rle */
+
+/*
+ * census_print:
+ *  Lists every kind of object, the most common first
+ *
+ */
+void
+census_print(const struct census *c, FILE *f)
+{
+  size_t i, j, n = 0;
+  struct entry *e, **all;
+
+  for (i = 0; i < BUCKETS; i++)
+    for (e = c->buckets[i]; e != NULL; e = e->next)
+      n++;
+  if ((all = malloc((n + 1) * sizeof(*all))) == NULL)
+    return;
+  n = 0;
+  for (i = 0; i < BUCKETS; i++)
+    for (e = c->buckets[i]; e != NULL; e = e->next)
+      all[n++] = e;
+  qsort(all, n, sizeof(*all), by_count);
+
+  fprintf(f, "%12s %7s %6s %5s  object\n", "count", "share", "period", "cells");
+  for (i = 0; i < n; i++) {
+    e = all[i];
+    fprintf(f, "%12llu %6.2f%% ", e->count, 100.0 * e->count / c->objects);
+    if (e->period != 0)
+      fprintf(f, "%6llu", e->period);
+    else
+      fprintf(f, "%6s", "?");
+    fprintf(f, " %5d  ", e->cells);
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); j++)
+      if (strcmp(names[j].key, e->key) == 0)
+        break;
+    if (j < sizeof(names) / sizeof(names[0]))
+      fputs(names[j].name, f);
+    else
+      rle(e->key, f);
+    fputc('\n', f);
+  }
+  free(all);
+} /* census_print */
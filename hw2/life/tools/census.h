@@ -0,0 +1,21 @@
+#ifndef __CENSUS_H
+#define __CENSUS_H
+#include <stdio.h>
+#include "board.h"
+
+/*
+ * A census of the objects left on settled boards.  Each board is cut
+ * into its connected groups of live cells, and every group is counted
+ * under a canonical form, the same whichever way it is turned or
+ * reflected and in whichever phase it was found.  Boards can be added
+ * from several threads at once.
+ *
+ */
+struct census;
+
+struct census *census_new(void);
+void census_free(struct census *c);
+int census_add(struct census *c, const struct board *b,
+               unsigned long long period);
+void census_print(const struct census *c, FILE *f);
+#endif
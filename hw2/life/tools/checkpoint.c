@@ -0,0 +1,538 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         checkpoint.c
+* Description:  Incremental checkpoints of a running game, written in the background
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+#define MAGIC "LIFECKPT"
+
+/*
+ * What precedes each record of the log, in the byte order of the host,
+ * followed by bytes of rows and a checksum of both.  A row is its
+ * number, the length of its encoding and the encoding: pairs of a run
+ * of empty words and a run of words given in full, 64 cells a word.
+ *
+ */
+struct rec {
+  char kind[4];                 /* "RECF" for a full board, "RECD" rows */
+  uint32_t rows;
+  uint64_t gen, bytes;
+  int32_t w, h, ox, oy, view_w, view_h, topology;
+  char rule[24];
+};
+
+/*
+ * A record being built
+ *
+ */
+struct buf {
+  unsigned char *p;
+  size_t len, cap;
+};
+
+static int
+reserve(struct buf *b, size_t n)
+{
+  unsigned char *p;
+  size_t cap = b->cap ? b->cap : 4096;
+
+  if (b->len + n <= b->cap)
+    return 0;
+  while (cap < b->len + n)
+    cap *= 2;
+  if ((p = realloc(b->p, cap)) == NULL)
+    return -1;
+  b->p = p;
+  b->cap = cap;
+  return 0;
+} /* reserve */
+
+static void
+put_varint(struct buf *b, uint64_t v)
+{
+  do {
+    b->p[b->len++] = (v & 0x7f) | (v >= 0x80 ? 0x80 : 0);
+    v >>= 7;
+  } while (v != 0);
+} /* put_varint */
+
+static int
+get_varint(const unsigned char **p, const unsigned char *end, uint64_t *v)
+{
+  int shift = 0;
+
+  *v = 0;
+  while (*p < end && shift < 64) {
+    *v |= (uint64_t)(**p & 0x7f) << shift;
+    if (!(*(*p)++ & 0x80))
+      return 0;
+    shift += 7;
+  }
+  return -1;
+} /* get_varint */
+
+static uint64_t
+fnv(uint64_t sum, const void *p, size_t n)
+{
+  const unsigned char *s = p;
+
+  while (n-- > 0) {
+    sum ^= *s++;
+    sum *= 0x100000001b3ull;
+  }
+  return sum;
+} /* fnv */
+
+/*
+ * pack:
+ *  Cells [x, x + 64) of a row of w as a word, cell x + i in bit i
+ *
+ */
+static uint64_t
+pack(const unsigned char *row, int x, int w)
+{
+  uint64_t v = 0, b;
+  int i;
+
+  if (w - x < 64) {
+    for (i = 0; i < w - x; i++)
+      v |= (uint64_t)row[x + i] << i;
+    return v;
+  }
+  /* the multiply gathers the low bit of each byte into the top byte */
+  for (i = 0; i < 8; i++) {
+    memcpy(&b, row + x + 8 * i, 8);
+    v |= ((b * 0x0102040810204080ull) >> 56) << (8 * i);
+  }
+  return v;
+} /* pack */
+
+/*
+ * encode_row:
+ *  Appends row y of w cells to b, encoded in t first; -1 if out of
+ *  memory
+ *
+ */
+static int
+encode_row(struct buf *b, struct buf *t, const unsigned char *row, int w,
+           int y)
+{
+  int i, j, n = (w + 63) / 64;
+  uint64_t v;
+
+  /* at most a pair of runs per word, and the words themselves */
+  t->len = 0;
+  if (reserve(t, (size_t)n * 28) != 0)
+    return -1;
+  for (i = 0; i < n; i = j) {
+    for (j = i; j < n && pack(row, 64 * j, w) == 0; j++)
+      ;
+    put_varint(t, j - i);
+    for (i = j; j < n && pack(row, 64 * j, w) != 0; j++)
+      ;
+    put_varint(t, j - i);
+    for (; i < j; i++) {
+      v = pack(row, 64 * i, w);
+      memcpy(t->p + t->len, &v, 8);
+      t->len += 8;
+    }
+  }
+  if (reserve(b, 20 + t->len) != 0)
+    return -1;
+  put_varint(b, y);
+  put_varint(b, t->len);
+  memcpy(b->p + b->len, t->p, t->len);
+  b->len += t->len;
+  return 0;
+} /* encode_row */
+
+/*
+ * decode_row:
+ *  Fills row of w cells from the encoding in [p, end); -1 if it does
+ *  not fit
+ *
+ */
+static int
+decode_row(const unsigned char *p, const unsigned char *end,
+           unsigned char *row, int w)
+{
+  int n = (w + 63) / 64, at = 0, x, k;
+  uint64_t zero, full, v;
+
+  memset(row, 0, w);
+  while (p < end) {
+    if (get_varint(&p, end, &zero) != 0 || zero > (uint64_t)(n - at)
+        || get_varint(&p, end, &full) != 0
+        || full > (uint64_t)(n - at) - zero
+        || (uint64_t)(end - p) < full * 8)
+      return -1;
+    for (at += zero; full-- > 0; at++) {
+      memcpy(&v, p, 8);
+      p += 8;
+      for (x = 64 * at, k = 0; k < 64 && x + k < w; k++)
+        row[x + k] = v >> k & 1;
+    }
+  }
+  return 0;
+} /* decode_row */
+
+/*
+ * sync_dir:
+ *  Makes a rename in the directory of path survive a crash
+ *
+ */
+static int
+sync_dir(const char *path)
+{
+  char *copy = strdup(path);
+  int fd, r = -1;
+
+  if (copy == NULL)
+    return -1;
+  if ((fd = open(dirname(copy), O_RDONLY)) >= 0) {
+    r = fsync(fd);
+    close(fd);
+  }
+  free(copy);
+  return r;
+} /* sync_dir */
+
+/*
+ * put_record:
+ *  Writes snap as a full record, in a new log that replaces the old,
+ *  or as the rows that changed since prev; -1 with errno set if it
+ *  could not be written
+ *
+ */
+static int
+put_record(struct checkpoint *c, struct buf *b, struct buf *t)
+{
+  struct rec r;
+  uint64_t sum;
+  int y, full;
+  char tmp[4096];
+  FILE *f;
+
+  full = c->f == NULL || c->pw != c->w || c->ph != c->h
+         || c->logged > c->full;
+  memset(&r, 0, sizeof(r));
+  memcpy(r.kind, full ? "RECF" : "RECD", 4);
+  r.gen = c->meta.gen;
+  r.w = c->w;
+  r.h = c->h;
+  r.ox = c->ox;
+  r.oy = c->oy;
+  r.view_w = c->meta.view_w;
+  r.view_h = c->meta.view_h;
+  r.topology = c->meta.topology;
+  memcpy(r.rule, c->meta.rule, sizeof(r.rule));
+  b->len = 0;
+  for (y = 0; y < c->h; y++) {
+    if (!full && memcmp(c->snap + (size_t)y * c->w,
+                        c->prev + (size_t)y * c->w, c->w) == 0)
+      continue;
+    if (encode_row(b, t, c->snap + (size_t)y * c->w, c->w, y) != 0)
+      return -1;
+    r.rows++;
+  }
+  r.bytes = b->len;
+  sum = fnv(fnv(0xcbf29ce484222325ull, &r, sizeof(r)), b->p, b->len);
+
+  if (full) {
+    snprintf(tmp, sizeof(tmp), "%s.tmp", c->path);
+    if ((f = fopen(tmp, "wb")) == NULL)
+      return -1;
+    if (fwrite(MAGIC, 1, 8, f) != 8 || fwrite(&r, sizeof(r), 1, f) != 1
+        || fwrite(b->p, 1, b->len, f) != b->len
+        || fwrite(&sum, sizeof(sum), 1, f) != 1
+        || fflush(f) != 0 || fsync(fileno(f)) != 0) {
+      fclose(f);
+      return -1;
+    }
+    if (c->f != NULL)
+      fclose(c->f);
+    c->f = f;
+    if (rename(tmp, c->path) != 0 || sync_dir(c->path) != 0)
+      return -1;
+    c->full = sizeof(r) + b->len;
+    c->logged = 0;
+  } else {
+    if (fwrite(&r, sizeof(r), 1, c->f) != 1
+        || fwrite(b->p, 1, b->len, c->f) != b->len
+        || fwrite(&sum, sizeof(sum), 1, c->f) != 1
+        || fflush(c->f) != 0 || fsync(fileno(c->f)) != 0)
+      return -1;
+    c->logged += sizeof(r) + b->len;
+  }
+  return 0;
+} /* put_record */
+
+/*
+ * writer:
+ *  The checkpoint thread: writes each copy handed to it, then keeps
+ *  it to tell the next one what changed
+ *
+ */
+static void *
+writer(void *arg)
+{
+  struct checkpoint *c = arg;
+  struct buf b = { NULL, 0, 0 }, row = { NULL, 0, 0 };
+  unsigned char *t;
+  size_t cap;
+  int err;
+
+  for (;;) {
+    pthread_mutex_lock(&c->lock);
+    while (!c->busy && !c->quit)
+      pthread_cond_wait(&c->wake, &c->lock);
+    pthread_mutex_unlock(&c->lock);
+    if (!c->busy)
+      break;
+    err = put_record(c, &b, &row) != 0 ? (errno ? errno : EIO) : 0;
+    t = c->prev;
+    c->prev = c->snap;
+    c->snap = t;
+    cap = c->prev_cap;
+    c->prev_cap = c->snap_cap;
+    c->snap_cap = cap;
+    /* what is on disk is not what was kept: the next must be in full */
+    c->pw = err != 0 ? 0 : c->w;
+    c->ph = c->h;
+    pthread_mutex_lock(&c->lock);
+    if (err != 0) {
+      if (!c->failed)
+        c->failed = err;
+      c->err = err;
+      c->lost++;
+      c->streak++;
+    } else
+      c->streak = 0;
+    c->busy = 0;
+    pthread_cond_broadcast(&c->done);
+    pthread_mutex_unlock(&c->lock);
+  }
+  free(b.p);
+  free(row.p);
+  return NULL;
+} /* writer */
+
+/*
+ * checkpoint_new:
+ *  Checkpoints to path, the first of which replaces whatever is there;
+ *  NULL if out of memory or no thread could be started
+ *
+ */
+struct checkpoint *
+checkpoint_new(const char *path)
+{
+  struct checkpoint *c = calloc(1, sizeof(*c));
+
+  if (c == NULL)
+    return NULL;
+  c->path = path;
+  pthread_mutex_init(&c->lock, NULL);
+  pthread_cond_init(&c->wake, NULL);
+  pthread_cond_init(&c->done, NULL);
+  if (pthread_create(&c->tid, NULL, writer, c) != 0) {
+    pthread_cond_destroy(&c->done);
+    pthread_cond_destroy(&c->wake);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+    return NULL;
+  }
+  return c;
+} /* checkpoint_new */
+
+/*
+ * checkpoint_free:
+ *  Waits for the checkpoint being written and stops; -1 with errno set
+ *  if any checkpoint could not be written
+ *
+ */
+int
+checkpoint_free(struct checkpoint *c)
+{
+  int failed;
+
+  if (c == NULL)
+    return 0;
+  pthread_mutex_lock(&c->lock);
+  c->quit = 1;
+  pthread_cond_signal(&c->wake);
+  pthread_mutex_unlock(&c->lock);
+  pthread_join(c->tid, NULL);
+  pthread_cond_destroy(&c->done);
+  pthread_cond_destroy(&c->wake);
+  pthread_mutex_destroy(&c->lock);
+  if (c->f != NULL && fclose(c->f) != 0 && !c->failed)
+    c->failed = errno;
+  failed = c->failed;
+  free(c->snap);
+  free(c->prev);
+  free(c);
+  errno = failed;
+  return failed ? -1 : 0;
+} /* checkpoint_free */
+
+/*
+ * checkpoint_take:
+ *  Copies the current generation of b to be written with m.  Returns
+ *  1 if the checkpoint before is still being written, unless wait is
+ *  set, in which case it waits for both to be written; -1 if out of
+ *  memory.
+ *
+ */
+int
+checkpoint_take(struct checkpoint *c, const struct board *b,
+                const struct checkpoint_meta *m, int wait)
+{
+  size_t size = (size_t)b->w * b->h;
+  unsigned char *p;
+  int y;
+
+  pthread_mutex_lock(&c->lock);
+  if (c->busy && !wait) {
+    pthread_mutex_unlock(&c->lock);
+    return 1;
+  }
+  while (c->busy)
+    pthread_cond_wait(&c->done, &c->lock);
+  pthread_mutex_unlock(&c->lock);
+
+  /* the writer is idle, and snap is ours until it is handed over */
+  if (size > c->snap_cap) {
+    if ((p = realloc(c->snap, size)) == NULL)
+      return -1;
+    c->snap = p;
+    c->snap_cap = size;
+  }
+  for (y = 0; y < b->h; y++)
+    memcpy(c->snap + (size_t)y * b->w, BOARD_CUR(b) + y * b->stride, b->w);
+  c->w = b->w;
+  c->h = b->h;
+  c->ox = b->ox;
+  c->oy = b->oy;
+  c->meta = *m;
+
+  pthread_mutex_lock(&c->lock);
+  c->busy = 1;
+  pthread_cond_signal(&c->wake);
+  while (wait && c->busy)
+    pthread_cond_wait(&c->done, &c->lock);
+  pthread_mutex_unlock(&c->lock);
+  return 0;
+} /* checkpoint_take */
+
+/*
+ * apply:
+ *  Applies the rows of record r, read from p, to b.  Every row is
+ *  checked before any is applied, so a bad record leaves b as it was.
+ *
+ */
+static int
+apply(struct board *b, const struct rec *r, const unsigned char *p)
+{
+  const unsigned char *end = p + r->bytes, *q;
+  unsigned char *row = malloc(b->w);
+  uint64_t y, len;
+  uint32_t i;
+  int pass;
+
+  if (row == NULL)
+    return -1;
+  for (pass = 0; pass < 2; pass++)
+    for (q = p, i = 0; i < r->rows; i++) {
+      if (get_varint(&q, end, &y) != 0 || y >= (uint64_t)b->h
+          || get_varint(&q, end, &len) != 0 || len > (uint64_t)(end - q)
+          || decode_row(q, q + len, pass ? BOARD_CUR(b) + y * b->stride : row,
+                        b->w) != 0) {
+        free(row);
+        return -1;
+      }
+      q += len;
+    }
+  free(row);
+  return 0;
+} /* apply */
+
+/*
+ * checkpoint_load:
+ *  The board of the last whole record in the log at path, with what m
+ *  says about it.  A record cut short or damaged ends the log.  NULL
+ *  with errno set if the file cannot be read, holds no full record,
+ *  or memory runs out.
+ *
+ */
+struct board *
+checkpoint_load(const char *path, struct checkpoint_meta *m)
+{
+  char magic[8];
+  struct rec r;
+  struct board *b = NULL, *nb;
+  unsigned char *p = NULL, *q;
+  uint64_t sum;
+  int err = EINVAL;
+  FILE *f = fopen(path, "rb");
+
+  if (f == NULL)
+    return NULL;
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, MAGIC, 8) != 0)
+    goto out;
+  while (fread(&r, sizeof(r), 1, f) == 1) {
+    int full = memcmp(r.kind, "RECF", 4) == 0;
+
+    if ((!full && memcmp(r.kind, "RECD", 4) != 0) || (!full && b == NULL)
+        || r.w <= 0 || r.h <= 0 || (b != NULL && !full
+                                    && (r.w != b->w || r.h != b->h)))
+      break;
+    if ((q = realloc(p, r.bytes ? r.bytes : 1)) == NULL) {
+      err = ENOMEM;
+      goto out;
+    }
+    p = q;
+    if (fread(p, 1, r.bytes, f) != r.bytes
+        || fread(&sum, sizeof(sum), 1, f) != 1
+        || sum != fnv(fnv(0xcbf29ce484222325ull, &r, sizeof(r)), p, r.bytes))
+      break;
+    if (full) {
+      if ((nb = board_new(r.w, r.h)) == NULL) {
+        err = ENOMEM;
+        goto out;
+      }
+      if (apply(nb, &r, p) != 0) {
+        board_free(nb);
+        break;
+      }
+      board_free(b);
+      b = nb;
+    } else if (apply(b, &r, p) != 0)
+      break;
+    b->ox = r.ox;
+    b->oy = r.oy;
+    b->topology = r.topology;
+    m->gen = r.gen;
+    m->view_w = r.view_w;
+    m->view_h = r.view_h;
+    m->topology = r.topology;
+    memcpy(m->rule, r.rule, sizeof(m->rule));
+    m->rule[sizeof(m->rule) - 1] = '\0';
+  }
+out:
+  fclose(f);
+  free(p);
+  if (b == NULL)
+    errno = err;
+  return b;
+} /* checkpoint_load */
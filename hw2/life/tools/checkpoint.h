@@ -0,0 +1,54 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "board.h"
+
+/*
+ * Checkpoints of a running game, so a long run can be resumed after
+ * it is stopped or the host goes down.  A checkpoint file is a log:
+ * a full record of the board, then records of only the rows that
+ * changed since the record before, each with a checksum so a record
+ * torn by a crash is ignored.  Rows are packed 64 cells to a word,
+ * with runs of empty words left out.  Once the changes outgrow the
+ * full record, a new file with a single full record replaces the log.
+ *
+ * The board is copied when a checkpoint is taken and written out by a
+ * thread of its own; a checkpoint asked for while the one before is
+ * still being written is skipped.  What became of each is kept in
+ * err, lost and streak, which are settled whenever checkpoint_take
+ * returns 0.
+ *
+ */
+struct checkpoint_meta {
+  unsigned long long gen;
+  int view_w, view_h;           /* the board as seen, before growth */
+  int topology;
+  char rule[24];
+};
+
+struct checkpoint {
+  const char *path;
+  FILE *f;                      /* the log, NULL until the first record */
+  long full, logged;            /* bytes of the full record, and since */
+  /* the copy being written and the one last written */
+  unsigned char *snap, *prev;
+  size_t snap_cap, prev_cap;
+  int w, h, ox, oy;             /* of snap */
+  int pw, ph;                   /* of prev, 0 if none */
+  struct checkpoint_meta meta;
+  int busy, quit, failed;       /* failed: errno of the first failure */
+  int err;                      /* errno of the last one lost */
+  unsigned long lost, streak;   /* checkpoints not written, and in a row */
+  pthread_mutex_t lock;
+  pthread_cond_t wake, done;
+  pthread_t tid;
+};
+
+struct checkpoint *checkpoint_new(const char *path);
+int checkpoint_free(struct checkpoint *c);
+int checkpoint_take(struct checkpoint *c, const struct board *b,
+                    const struct checkpoint_meta *m, int wait);
+struct board *checkpoint_load(const char *path, struct checkpoint_meta *m);
+#endif
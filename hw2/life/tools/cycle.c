@@ -0,0 +1,84 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         cycle.c
+* Description:  Still life and oscillator detection from board hashes
+*
+*******************************************************************************
+*/
+
+#include <stdlib.h>
+#include "cycle.h"
+
+/*
+ * cycle_new:
+ *  A ring of size hashes; NULL if out of memory
+ *
+ */
+struct cycle *
+cycle_new(int size)
+{
+  struct cycle *c = calloc(1, sizeof(*c));
+
+  if (c == NULL)
+    return NULL;
+  c->size = size > 0 ? size : 1;
+  c->hash = calloc(c->size, sizeof(*c->hash));
+  c->gen = calloc(c->size, sizeof(*c->gen));
+  if (c->hash == NULL || c->gen == NULL) {
+    cycle_free(c);
+    return NULL;
+  }
+  return c;
+} /* cycle_new */
+
+void
+cycle_free(struct cycle *c)
+{
+  if (c == NULL)
+    return;
+  free(c->hash);
+  free(c->gen);
+  free(c);
+} /* cycle_free */
+
+/*
+ * cycle_reset:
+ *  Forgets every hash, for a new board
+ *
+ */
+void
+cycle_reset(struct cycle *c)
+{
+  c->n = 0;
+  c->head = 0;
+} /* cycle_reset */
+
+/*
+ * cycle_check:
+ *  Records the hash of generation gen.  Returns how many generations
+ *  ago the board last had that hash, the shortest period seen, or 0
+ *  if it is new to the ring.
+ *
+ */
+unsigned long long
+cycle_check(struct cycle *c, uint64_t hash, unsigned long long gen)
+{
+  int i, k;
+  unsigned long long period = 0;
+
+  /* newest first, so the first match is the shortest period */
+  for (i = 0; i < c->n; i++) {
+    k = (c->head - 1 - i + c->size) % c->size;
+    if (c->hash[k] == hash) {
+      period = gen - c->gen[k];
+      break;
+    }
+  }
+  c->hash[c->head] = hash;
+  c->gen[c->head] = gen;
+  c->head = (c->head + 1) % c->size;
+  if (c->n < c->size)
+    c->n++;
+  return period;
+} /* cycle_check */
@@ -0,0 +1,25 @@
+#ifndef __CYCLE_H
+#define __CYCLE_H
+#include <stdint.h>
+
+/*
+ * Spots a board that repeats itself: the hashes of the last size
+ * generations seen are kept in a ring, and a hash met again means the
+ * board went back to an earlier state.  A still life repeats after one
+ * generation; an oscillator of period p after p.
+ *
+ */
+struct cycle {
+  int size;                     /* entries in the ring */
+  int n;                        /* entries in use */
+  int head;                     /* where the next one goes */
+  uint64_t *hash;
+  unsigned long long *gen;
+};
+
+struct cycle *cycle_new(int size);
+void cycle_free(struct cycle *c);
+void cycle_reset(struct cycle *c);
+unsigned long long cycle_check(struct cycle *c, uint64_t hash,
+                               unsigned long long gen);
+#endif
@@ -0,0 +1,177 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         display.c
+* Description:  Terminal drawing on its own thread, fed through a triple buffer
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "display.h"
+
+#define FRESH 4                 /* in ready: not drawn yet */
+
+/*
+ * pace:
+ *  Works out when the frame after the one just drawn is due.  A
+ *  display that has fallen behind counts again from now instead of
+ *  catching up.
+ *
+ */
+static void
+pace(struct display *d)
+{
+  struct timespec now;
+
+  d->due.tv_nsec += d->period;
+  d->due.tv_sec += d->due.tv_nsec / 1000000000L;
+  d->due.tv_nsec %= 1000000000L;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (now.tv_sec > d->due.tv_sec
+      || (now.tv_sec == d->due.tv_sec && now.tv_nsec > d->due.tv_nsec))
+    d->due = now;
+} /* pace */
+
+/*
+ * drawer:
+ *  The display thread: draws the latest frame whenever there is a new
+ *  one and the frame rate allows, until told to quit and nothing is
+ *  left to draw
+ *
+ */
+static void *
+drawer(void *arg)
+{
+  struct display *d = arg;
+
+  for (;;) {
+    pthread_mutex_lock(&d->lock);
+    /* frames posted meanwhile replace each other, and are dropped */
+    while (d->period != 0 && !d->quit
+           && pthread_cond_timedwait(&d->wake, &d->lock, &d->due) != ETIMEDOUT)
+      ;
+    while (!(__atomic_load_n(&d->ready, __ATOMIC_ACQUIRE) & FRESH)
+           && !d->quit)
+      pthread_cond_wait(&d->wake, &d->lock);
+    pthread_mutex_unlock(&d->lock);
+    if (!(__atomic_load_n(&d->ready, __ATOMIC_ACQUIRE) & FRESH))
+      break;
+    d->front = __atomic_exchange_n(&d->ready, d->front, __ATOMIC_ACQ_REL) & 3;
+    if (render_frame(d->r, d->frame[d->front], d->w,
+                     d->status[d->front]) != 0) {
+      __atomic_store_n(&d->failed, 1, __ATOMIC_RELEASE);
+      break;
+    }
+    if (d->period != 0)
+      pace(d);
+  }
+  return NULL;
+} /* drawer */
+
+/*
+ * display_new:
+ *  A display of a w-by-h board on fd, showing at most fps frames a
+ *  second (no limit if fps <= 0); NULL if out of memory or no thread
+ *  could be started
+ *
+ */
+struct display *
+display_new(int w, int h, int fd, double fps)
+{
+  int i;
+  struct display *d = calloc(1, sizeof(*d));
+  pthread_condattr_t attr;
+
+  if (d == NULL)
+    return NULL;
+  d->w = w;
+  d->h = h;
+  d->back = 0;
+  d->ready = 1;
+  d->front = 2;
+  for (i = 0; i < 3; i++)
+    if ((d->frame[i] = malloc((size_t)w * h)) == NULL)
+      goto fail;
+  if ((d->r = render_new(w, h, fd)) == NULL)
+    goto fail;
+  d->period = fps > 0 ? (long)(1e9 / fps) : 0;
+  clock_gettime(CLOCK_MONOTONIC, &d->due);
+  pthread_mutex_init(&d->lock, NULL);
+  /* due is on the monotonic clock, as the wait for it must be */
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&d->wake, &attr);
+  pthread_condattr_destroy(&attr);
+  if (pthread_create(&d->tid, NULL, drawer, d) != 0) {
+    pthread_cond_destroy(&d->wake);
+    pthread_mutex_destroy(&d->lock);
+    goto fail;
+  }
+  return d;
+
+fail:
+  render_free(d->r);
+  for (i = 0; i < 3; i++)
+    free(d->frame[i]);
+  free(d);
+  return NULL;
+} /* display_new */
+
+/*
+ * display_free:
+ *  Draws the last frame posted, if it was not, and closes the display
+ *
+ */
+void
+display_free(struct display *d)
+{
+  int i;
+
+  if (d == NULL)
+    return;
+  pthread_mutex_lock(&d->lock);
+  d->quit = 1;
+  pthread_cond_signal(&d->wake);
+  pthread_mutex_unlock(&d->lock);
+  pthread_join(d->tid, NULL);
+  pthread_cond_destroy(&d->wake);
+  pthread_mutex_destroy(&d->lock);
+  render_free(d->r);
+  for (i = 0; i < 3; i++)
+    free(d->frame[i]);
+  free(d);
+} /* display_free */
+
+/*
+ * display_post:
+ *  Hands the board g over to be drawn with status below it.  Never
+ *  waits for the terminal: if the frame posted before has not been
+ *  picked up yet, this one takes its place.
+ *
+ */
+void
+display_post(struct display *d, const unsigned char *g, int stride,
+             const char *status)
+{
+  int y, old;
+
+  for (y = 0; y < d->h; y++)
+    memcpy(d->frame[d->back] + (size_t)y * d->w, g + (size_t)y * stride, d->w);
+  strncpy(d->status[d->back], status != NULL ? status : "", DISPLAY_STATUS - 1);
+  d->status[d->back][DISPLAY_STATUS - 1] = '\0';
+  old = __atomic_exchange_n(&d->ready, d->back | FRESH, __ATOMIC_ACQ_REL);
+  d->back = old & 3;
+  d->posted++;
+  if (old & FRESH) {
+    d->dropped++;
+    return;
+  }
+  /* the thread may be asleep waiting for this */
+  pthread_mutex_lock(&d->lock);
+  pthread_cond_signal(&d->wake);
+  pthread_mutex_unlock(&d->lock);
+} /* display_post */
+
@@ -0,0 +1,40 @@
+#ifndef __DISPLAY_H
+#define __DISPLAY_H
+#include <pthread.h>
+#include <time.h>
+#include "render.h"
+
+#define DISPLAY_STATUS 128
+
+/*
+ * A display draws frames on a thread of its own, so that evolving
+ * never waits for the terminal.  Frames are handed over through three
+ * buffers: the one being filled, the one being drawn, and the latest
+ * finished frame waiting in between.  A frame posted before the last
+ * one was picked up replaces it, and counts as dropped.  The thread
+ * sleeps between frames to keep to the frame rate; evolution never
+ * does.
+ *
+ */
+struct display {
+  struct render *r;
+  int w, h;
+  unsigned char *frame[3];      /* w-by-h cells each */
+  char status[3][DISPLAY_STATUS];
+  int back;                     /* filled by display_post */
+  int ready;                    /* latest frame, | FRESH until drawn */
+  int front;                    /* drawn by the thread */
+  int quit, failed;
+  long period;                  /* nanoseconds between frames, 0 uncapped */
+  struct timespec due;          /* when the next frame may be drawn */
+  unsigned long long posted, dropped;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t tid;
+};
+
+struct display *display_new(int w, int h, int fd, double fps);
+void display_free(struct display *d);
+void display_post(struct display *d, const unsigned char *g, int stride,
+                  const char *status);
+#endif
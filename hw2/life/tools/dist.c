@@ -0,0 +1,499 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         dist.c
+* Description:  A board split across processes that swap halo rows
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "dist.h"
+#include "board.h"
+#include "grid.h"
+
+#define CACHELINE 64
+#define RING_SLOTS 4    /* a band is never more than a generation ahead */
+
+/*
+ * A single-producer single-consumer ring of rows.  The producer only
+ * writes head and the consumer only tail, each on a line of its own;
+ * a row is published by the release store of head after it is copied
+ * in, and its slot freed by the release store of tail.
+ *
+ */
+struct ring {
+  unsigned long long head __attribute__((aligned(CACHELINE)));
+  unsigned long long tail __attribute__((aligned(CACHELINE)));
+  unsigned char slot[] __attribute__((aligned(CACHELINE)));
+};
+
+enum { FROM_ABOVE, FROM_BELOW };
+
+/*
+ * Where one process is, written by it alone
+ *
+ */
+struct dist_state {
+  unsigned long long gen;
+  int cur;                      /* which grid of the band is current */
+} __attribute__((aligned(CACHELINE)));
+
+/*
+ * The segment every process shares: what the parent asks of the
+ * workers, where each of them is, and then two rings per band for the
+ * rows coming into it from above and below
+ *
+ */
+struct dist_ctl {
+  pthread_mutex_t lock;
+  pthread_cond_t go, done;
+  unsigned long long target;    /* generation to run to */
+  int quit;
+  int ready;                    /* bands seeded */
+  size_t slot;                  /* bytes per row in a ring */
+  size_t ring;                  /* bytes per ring */
+  size_t rings;                 /* offset of the first ring */
+  struct dist_state state[];
+};
+
+static struct ring *
+ring_of(struct dist_ctl *ctl, int band, int from)
+{
+  return (struct ring *)((char *)ctl + ctl->rings
+                         + (2 * (size_t)band + from) * ctl->ring);
+} /* ring_of */
+
+/*
+ * spin:
+ *  Waits a little for another process, giving up the core once it has
+ *  waited a while, as there may be more processes than cores
+ *
+ */
+static inline void
+spin(unsigned *spins)
+{
+  if (++*spins < 1024) {
+#ifdef __SSE2__
+    _mm_pause();
+#endif
+  } else
+    sched_yield();
+} /* spin */
+
+static void
+ring_put(struct ring *r, size_t slot, const unsigned char *row, int w)
+{
+  unsigned long long head = r->head;
+  unsigned spins = 0;
+
+  while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= RING_SLOTS)
+    spin(&spins);
+  memcpy(r->slot + head % RING_SLOTS * slot, row, w);
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+} /* ring_put */
+
+static void
+ring_get(struct ring *r, size_t slot, unsigned char *row, int w)
+{
+  unsigned long long tail = r->tail;
+  unsigned spins = 0;
+
+  while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+    spin(&spins);
+  memcpy(row, r->slot + tail % RING_SLOTS * slot, w);
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+} /* ring_get */
+
+/*
+ * lock:
+ *  Takes the shared lock, even from a process that died holding it
+ *
+ */
+static void
+lock(struct dist_ctl *ctl)
+{
+  if (pthread_mutex_lock(&ctl->lock) == EOWNERDEAD)
+    pthread_mutex_consistent(&ctl->lock);
+} /* lock */
+
+/*
+ * step:
+ *  Advances band i of d one generation: trades its edge rows with the
+ *  bands above and below for their own, which become its ghost rows,
+ *  and evolves it
+ *
+ */
+static void
+step(struct dist *d, int i, int *cur)
+{
+  struct dist_band *bd = &d->band[i];
+  size_t slot = d->ctl->slot;
+  int torus = d->topology == BOARD_TORUS, rows = bd->y1 - bd->y0, y;
+  int up = i > 0 || torus, down = i < d->n - 1 || torus;
+  unsigned char *g = bd->grid[*cur];
+
+  /* both rows go out before either comes in, or neighbours would wait
+     on each other */
+  if (up)
+    ring_put(ring_of(d->ctl, (i + d->n - 1) % d->n, FROM_BELOW), slot, g,
+             d->w);
+  if (down)
+    ring_put(ring_of(d->ctl, (i + 1) % d->n, FROM_ABOVE), slot,
+             g + (rows - 1) * d->stride, d->w);
+  if (up)
+    ring_get(ring_of(d->ctl, i, FROM_ABOVE), slot, g - d->stride, d->w);
+  if (down)
+    ring_get(ring_of(d->ctl, i, FROM_BELOW), slot, g + rows * d->stride,
+             d->w);
+  if (torus)
+    for (y = -1; y <= rows; y++) {
+      g[y * d->stride - 1] = g[y * d->stride + d->w - 1];
+      g[y * d->stride + d->w] = g[y * d->stride];
+    }
+  evolve_grid_rows(g, bd->grid[!*cur], d->w, d->stride, 0, rows);
+  *cur = !*cur;
+} /* step */
+
+/*
+ * worker:
+ *  What the process of band i does: fill its band, then run it to
+ *  whatever generation the parent sets, until told to quit
+ *
+ */
+static void
+worker(struct dist *d, int i, dist_fill_t fill, void *arg)
+{
+  struct dist_ctl *ctl = d->ctl;
+  struct dist_state *st = &ctl->state[i];
+  struct dist_band *bd = &d->band[i];
+  int cur = 0;
+
+  fill(arg, bd->grid[0], d->stride, bd->y0, bd->y1);
+  lock(ctl);
+  ctl->ready++;
+  pthread_cond_broadcast(&ctl->done);
+  for (;;) {
+    while (st->gen >= ctl->target && !ctl->quit)
+      pthread_cond_wait(&ctl->go, &ctl->lock);
+    if (ctl->quit)
+      break;
+    pthread_mutex_unlock(&ctl->lock);
+    /* the target may be brought forward while running */
+    while (st->gen < __atomic_load_n(&ctl->target, __ATOMIC_ACQUIRE)) {
+      step(d, i, &cur);
+      st->cur = cur;
+      __atomic_store_n(&st->gen, st->gen + 1, __ATOMIC_RELEASE);
+    }
+    lock(ctl);
+    pthread_cond_broadcast(&ctl->done);
+  }
+  pthread_mutex_unlock(&ctl->lock);
+} /* worker */
+
+/*
+ * shared:
+ *  len bytes of zeroes that survive a fork as the same memory
+ *
+ */
+static void *
+shared(size_t len)
+{
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+  return p == MAP_FAILED ? NULL : p;
+} /* shared */
+
+/*
+ * reap:
+ *  Whether any worker has gone, in which case all of them are stopped
+ *  and d can only be freed
+ *
+ */
+static int
+reap(struct dist *d)
+{
+  int i, gone = 0;
+
+  for (i = 0; i < d->n; i++)
+    if (d->band[i].pid > 0 && waitpid(d->band[i].pid, NULL, WNOHANG) != 0) {
+      d->band[i].pid = 0;
+      gone = 1;
+    }
+  if (gone)
+    for (i = 0; i < d->n; i++)
+      if (d->band[i].pid > 0) {
+        kill(d->band[i].pid, SIGKILL);
+        waitpid(d->band[i].pid, NULL, 0);
+        d->band[i].pid = 0;
+      }
+  return gone;
+} /* reap */
+
+/*
+ * wait_for:
+ *  Waits, holding the lock, until every band is ready and at the
+ *  target; brings the target forward to stop early once *go drops.
+ *  -1 with errno set to ECHILD if a worker died.
+ *
+ */
+static int
+wait_for(struct dist *d, const int *go)
+{
+  struct dist_ctl *ctl = d->ctl;
+  struct timespec ts;
+  unsigned long long most;
+  int i, behind, stopping = 0;
+
+  for (;;) {
+    for (behind = ctl->ready < d->n, i = 0; i < d->n && !behind; i++)
+      behind = __atomic_load_n(&ctl->state[i].gen, __ATOMIC_ACQUIRE)
+               < ctl->target;
+    if (!behind)
+      return 0;
+    if (go != NULL && !*go && !stopping && ctl->ready == d->n) {
+      /* a band may be a step past what it shows, but no further */
+      for (most = 0, i = 0; i < d->n; i++)
+        if (__atomic_load_n(&ctl->state[i].gen, __ATOMIC_ACQUIRE) > most)
+          most = ctl->state[i].gen;
+      if (most + 1 < ctl->target)
+        __atomic_store_n(&ctl->target, most + 1, __ATOMIC_RELEASE);
+      stopping = 1;
+      continue;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_nsec += 100000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000;
+    }
+    if (pthread_cond_timedwait(&ctl->done, &ctl->lock, &ts) == EOWNERDEAD)
+      pthread_mutex_consistent(&ctl->lock);
+    if (reap(d)) {
+      errno = ECHILD;
+      return -1;
+    }
+  }
+} /* wait_for */
+
+/*
+ * dist_new:
+ *  Splits a w-by-h board into n bands and starts a process for each,
+ *  which fills its rows [y0, y1) with fill(arg, g, stride, y0, y1), g
+ *  pointing at row y0.  NULL with errno set if out of memory or
+ *  processes.
+ *
+ */
+struct dist *
+dist_new(int w, int h, int n, int topology, dist_fill_t fill, void *arg)
+{
+  struct dist *d;
+  struct dist_ctl *ctl;
+  pthread_mutexattr_t ma;
+  pthread_condattr_t ca;
+  size_t grid, slot, rings;
+  pid_t parent = getpid();
+  int i, j, err;
+
+  if (n > h) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((d = calloc(1, sizeof(*d))) == NULL
+      || (d->band = calloc(n, sizeof(*d->band))) == NULL) {
+    free(d);
+    return NULL;
+  }
+  d->w = w;
+  d->h = h;
+  d->n = n;
+  d->topology = topology;
+  d->stride = grid_stride(w);
+
+  slot = ((size_t)w + CACHELINE - 1) & ~(size_t)(CACHELINE - 1);
+  rings = (sizeof(*ctl) + n * sizeof(struct dist_state) + CACHELINE - 1)
+          & ~(size_t)(CACHELINE - 1);
+  d->ctl_len = rings + 2 * n * (sizeof(struct ring) + RING_SLOTS * slot);
+  if ((ctl = d->ctl = shared(d->ctl_len)) == NULL)
+    goto fail;
+  ctl->slot = slot;
+  ctl->ring = sizeof(struct ring) + RING_SLOTS * slot;
+  ctl->rings = rings;
+  pthread_mutexattr_init(&ma);
+  pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&ctl->lock, &ma);
+  pthread_mutexattr_destroy(&ma);
+  pthread_condattr_init(&ca);
+  pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+  pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+  pthread_cond_init(&ctl->go, &ca);
+  pthread_cond_init(&ctl->done, &ca);
+  pthread_condattr_destroy(&ca);
+
+  /* a band and its ghost rows, twice, laid out as grid_new_n does */
+  for (i = 0; i < n; i++) {
+    struct dist_band *bd = &d->band[i];
+
+    bd->y0 = (long)h * i / n;
+    bd->y1 = (long)h * (i + 1) / n;
+    grid = CACHELINE + (size_t)(bd->y1 - bd->y0 + 2) * d->stride;
+    bd->len = CACHELINE + 2 * grid;
+    if ((bd->base = shared(bd->len)) == NULL)
+      goto fail;
+    for (j = 0; j < 2; j++)
+      bd->grid[j] = bd->base + CACHELINE + j * grid + CACHELINE + d->stride;
+  }
+
+  for (i = 0; i < n; i++) {
+    if ((d->band[i].pid = fork()) < 0)
+      goto fail;
+    if (d->band[i].pid == 0) {
+      /* die with the parent; it alone hears ^C and stops the bands */
+      prctl(PR_SET_PDEATHSIG, SIGKILL);
+      if (getppid() != parent)
+        _exit(EXIT_FAILURE);
+      signal(SIGINT, SIG_IGN);
+      for (j = 0; j < n; j++)
+        if (j != i)
+          munmap(d->band[j].base, d->band[j].len);
+      worker(d, i, fill, arg);
+      _exit(EXIT_SUCCESS);
+    }
+  }
+  lock(ctl);
+  err = wait_for(d, NULL);
+  pthread_mutex_unlock(&ctl->lock);
+  if (err == 0)
+    return d;
+
+fail:
+  err = errno;
+  dist_free(d);
+  errno = err;
+  return NULL;
+} /* dist_new */
+
+/*
+ * dist_free:
+ *  Stops the processes and releases the bands
+ *
+ */
+void
+dist_free(struct dist *d)
+{
+  int i;
+
+  if (d == NULL)
+    return;
+  if (d->ctl != NULL) {
+    lock(d->ctl);
+    d->ctl->quit = 1;
+    pthread_cond_broadcast(&d->ctl->go);
+    pthread_mutex_unlock(&d->ctl->lock);
+  }
+  for (i = 0; i < d->n; i++) {
+    if (d->band[i].pid > 0)
+      waitpid(d->band[i].pid, NULL, 0);
+    if (d->band[i].base != NULL)
+      munmap(d->band[i].base, d->band[i].len);
+  }
+  if (d->ctl != NULL)
+    munmap(d->ctl, d->ctl_len);
+  free(d->band);
+  free(d);
+} /* dist_free */
+
+/*
+ * dist_run:
+ *  Advances the board gens generations, or fewer if *go drops to 0
+ *  meanwhile, and waits for every band to get there; -1 with errno set
+ *  if a process died, after which d can only be freed
+ *
+ */
+int
+dist_run(struct dist *d, unsigned long long gens, const int *go)
+{
+  int r;
+
+  lock(d->ctl);
+  __atomic_store_n(&d->ctl->target, d->ctl->target + gens, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&d->ctl->go);
+  r = wait_for(d, go);
+  d->gen = d->ctl->target;
+  pthread_mutex_unlock(&d->ctl->lock);
+  return r;
+} /* dist_run */
+
+/*
+ * dist_gather:
+ *  Copies the current generation of every band into the w-by-h grid g
+ *
+ */
+void
+dist_gather(const struct dist *d, unsigned char *g, int stride)
+{
+  int i, y;
+
+  for (i = 0; i < d->n; i++) {
+    const struct dist_band *bd = &d->band[i];
+    const unsigned char *src = bd->grid[d->ctl->state[i].cur];
+
+    for (y = bd->y0; y < bd->y1; y++)
+      memcpy(g + (size_t)y * stride, src + (size_t)(y - bd->y0) * d->stride,
+             d->w);
+  }
+} /* dist_gather */
+
+/*
+ * dist_checksum:
+ *  grid_checksum of the current generation, band after band
+ *
+ */
+uint64_t
+dist_checksum(const struct dist *d)
+{
+  uint64_t sum = 0;
+  int i;
+
+  for (i = 0; i < d->n; i++) {
+    const struct dist_band *bd = &d->band[i];
+    const unsigned char *g = bd->grid[d->ctl->state[i].cur];
+
+    sum = i == 0 ? grid_checksum(g, d->w, bd->y1 - bd->y0, d->stride)
+                 : grid_checksum_more(sum, g, d->w, bd->y1 - bd->y0,
+                                      d->stride);
+  }
+  return sum;
+} /* dist_checksum */
+
+/*
+ * dist_population:
+ *  Live cells in the current generation of every band
+ *
+ */
+uint64_t
+dist_population(const struct dist *d)
+{
+  uint64_t n = 0;
+  int i;
+
+  for (i = 0; i < d->n; i++)
+    n += grid_population(d->band[i].grid[d->ctl->state[i].cur], d->w,
+                         d->band[i].y1 - d->band[i].y0, d->stride);
+  return n;
+} /* dist_population */
@@ -0,0 +1,45 @@
+#ifndef __DIST_H
+#define __DIST_H
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * A board split into horizontal bands, each evolved by a process of
+ * its own in a shared memory segment of its own, so the board is not
+ * bound by what one process can hold.  Between generations a process
+ * only hands the rows at the edges of its band to the processes above
+ * and below, through lock-free rings in a segment all of them share;
+ * nothing else is synchronised until the parent asks where they are.
+ *
+ */
+typedef void (*dist_fill_t)(void *arg, unsigned char *g, int stride,
+                            int y0, int y1);
+
+struct dist_ctl;
+
+struct dist_band {
+  unsigned char *base;          /* the band's segment */
+  size_t len;
+  unsigned char *grid[2];       /* its two generations, rows [y0, y1) */
+  int y0, y1;
+  pid_t pid;                    /* the process evolving it */
+};
+
+struct dist {
+  int w, h, n;                  /* the board, and bands or processes */
+  int topology;                 /* BOARD_DEAD or BOARD_TORUS */
+  int stride;
+  unsigned long long gen;       /* the generation every band is at */
+  struct dist_ctl *ctl;         /* shared by all the processes */
+  size_t ctl_len;
+  struct dist_band *band;
+};
+
+struct dist *dist_new(int w, int h, int n, int topology,
+                      dist_fill_t fill, void *arg);
+void dist_free(struct dist *d);
+int dist_run(struct dist *d, unsigned long long gens, const int *go);
+void dist_gather(const struct dist *d, unsigned char *g, int stride);
+uint64_t dist_checksum(const struct dist *d);
+uint64_t dist_population(const struct dist *d);
+#endif
@@ -0,0 +1,772 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         grid.c
+* Description:  Byte-per-cell grid and its vectorised evolve kernels
+*
+*******************************************************************************
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GRID_X86
+#endif
+#include "grid.h"
+#include "rule.h"
+
+#define CACHELINE 64
+#define HUGEPAGE (2 << 20)      /* x86 and arm64 huge page */
+#define COLOURS 8               /* starting offsets of mapped grids */
+#define COLOUR_STEP (32768 + 8 * CACHELINE)
+
+/*
+ * map:
+ *  Maps len bytes, len a multiple of HUGEPAGE, on a huge page
+ *  boundary: from the huge page pool if the administrator reserved
+ *  one, else as ordinary memory the kernel is asked to back with
+ *  transparent huge pages.  Pages are zero and only placed on a NUMA
+ *  node when first written.  NULL if out of memory.
+ *
+ */
+static void *
+map(size_t len)
+{
+  char *p, *q;
+
+#ifdef MAP_HUGETLB
+  p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED)
+    return p;
+#endif
+  /* map a huge page more than needed, then trim it to the boundary */
+  p = mmap(NULL, len + HUGEPAGE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  q = (char *)(((uintptr_t)p + HUGEPAGE - 1) & ~(uintptr_t)(HUGEPAGE - 1));
+  if (q > p)
+    munmap(p, q - p);
+  munmap(q + len, p + HUGEPAGE - q);
+#ifdef MADV_HUGEPAGE
+  madvise(q, len, MADV_HUGEPAGE);
+#endif
+  return q;
+} /* map */
+
+/*
+ * grid_stride:
+ *  Bytes from one row of a w-wide grid to the next: room for the ghost
+ *  cells, rounded up to whole cache lines so that every row starts on
+ *  one, but never a multiple of 4 KB, which would put the rows above
+ *  and below a cell on the same cache sets
+ *
+ */
+int
+grid_stride(int w)
+{
+  int stride = (w + 2 + CACHELINE - 1) & ~(CACHELINE - 1);
+
+  return stride % 4096 == 0 ? stride + CACHELINE : stride;
+} /* grid_stride */
+
+/*
+ * grid_new_n:
+ *  Allocates n all-dead w-by-h grids with their ghost borders in one
+ *  block of memory and stores the row stride; -1 if out of memory.
+ *  Each grid and each of its rows starts on a cache line, and the
+ *  ghost cell left of a row is the last byte of the row above.
+ *  Blocks of a huge page or more are mapped on huge pages and left
+ *  untouched, so that whichever thread writes a row first places it.
+ *  Every grid starts at its own offset into a huge page: two grids at
+ *  the same offset of physically contiguous pages would put the rows
+ *  an evolve reads and writes on the same cache sets, which costs a
+ *  third of the speed.  A cache line in front of the first grid
+ *  records how the block was allocated; grid_free on the first grid
+ *  releases them all.
+ *
+ */
+int
+grid_new_n(int w, int h, int n, unsigned char **g, int *stride)
+{
+  static unsigned colour;
+  void *start;
+  unsigned char *base;
+  size_t grid, span, size, len = 0, off = 0;
+  int i;
+
+  *stride = grid_stride(w);
+  /* a cache line for the ghost above-left of the first cell, then rows */
+  grid = CACHELINE + (size_t)(h + 2) * *stride;
+  size = CACHELINE + n * grid;
+  if (size >= HUGEPAGE) {
+    span = ((grid + HUGEPAGE - 1) & ~(size_t)(HUGEPAGE - 1)) + COLOUR_STEP;
+    off = __atomic_fetch_add(&colour, 1, __ATOMIC_RELAXED) % COLOURS
+          * (size_t)COLOUR_STEP;
+    size = off + CACHELINE + (n - 1) * span + grid;
+    len = (size + HUGEPAGE - 1) & ~(size_t)(HUGEPAGE - 1);
+    if ((start = map(len)) == NULL)
+      return -1;
+  } else {
+    span = grid;
+    if (posix_memalign(&start, CACHELINE, size) != 0)
+      return -1;
+    memset(start, 0, size);
+  }
+  base = (unsigned char *)start + off;
+  ((void **)base)[0] = start;
+  ((size_t *)base)[1] = len;
+  for (i = 0; i < n; i++)
+    g[i] = base + CACHELINE + i * span + CACHELINE + *stride;
+  return 0;
+} /* grid_new_n */
+
+/*
+ * grid_new:
+ *  Allocates one grid as grid_new_n does; NULL if out of memory
+ *
+ */
+unsigned char *
+grid_new(int w, int h, int *stride)
+{
+  unsigned char *g;
+
+  return grid_new_n(w, h, 1, &g, stride) == 0 ? g : NULL;
+} /* grid_new */
+
+void
+grid_free(unsigned char *g, int stride)
+{
+  unsigned char *base;
+
+  if (g == NULL)
+    return;
+  base = g - stride - 2 * CACHELINE;
+  if (((size_t *)base)[1] != 0)
+    munmap(((void **)base)[0], ((size_t *)base)[1]);
+  else
+    free(((void **)base)[0]);
+} /* grid_free */
+
+/*
+ * grid_pages:
+ *  Finds in /proc/self/smaps the mapping that holds grid g and stores
+ *  its size, the page size backing it and how much of it is on
+ *  transparent huge pages, all in bytes; -1 if that cannot be told
+ *
+ */
+int
+grid_pages(const unsigned char *g, long *size, long *page, long *huge)
+{
+  char line[256];
+  unsigned long lo, hi, kb;
+  int found = 0, got = 0;
+  FILE *f = fopen("/proc/self/smaps", "r");
+
+  if (f == NULL)
+    return -1;
+  *size = *page = *huge = 0;
+  while (got < 3 && fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2)
+      found = lo <= (uintptr_t)g && (uintptr_t)g < hi;
+    else if (!found)
+      continue;
+    else if (sscanf(line, "Size: %lu kB", &kb) == 1)
+      *size = kb << 10, got++;
+    else if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1)
+      *page = kb << 10, got++;
+    else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1)
+      *huge = kb << 10, got++;
+  }
+  fclose(f);
+  return got == 3 ? 0 : -1;
+} /* grid_pages */
+
+/*
+ * grid_wrap:
+ *  Fills the ghost cells of g from the opposite edges, making it a
+ *  torus for the next generation
+ *
+ */
+void
+grid_wrap(unsigned char *g, int w, int h, int stride)
+{
+  int y;
+
+  for (y = 0; y < h; y++) {
+    g[y * stride - 1] = g[y * stride + w - 1];
+    g[y * stride + w] = g[y * stride];
+  }
+  /* whole rows, ghost columns included, which also fills the corners */
+  memcpy(g - stride - 1, g + (h - 1) * stride - 1, w + 2);
+  memcpy(g + h * stride - 1, g - 1, w + 2);
+} /* grid_wrap */
+
+/*
+ * The rule the kernels apply: the full neighbourhood table for the
+ * scalar kernel, the neighbour counts that give birth and survival for
+ * the compare-based SSE2 kernel, and both as 16-entry byte tables for
+ * the shuffle-based AVX2 kernel
+ *
+ */
+static struct rule rule;
+static int have_rule, life;
+static int born_n[9], nborn, stay_n[9], nstay;
+static unsigned char born_tbl[16], stay_tbl[16];
+
+/*
+ * word:
+ *  The 64 cells from x as bits, or fewer at the end of a row
+ *
+ */
+static inline uint64_t
+word(const unsigned char *row, int x, int w)
+{
+  int i;
+  uint64_t v = 0;
+
+  if (w - x < 64) {
+    for (i = 0; i < w - x; i++)
+      v |= (uint64_t)row[x + i] << i;
+    return v;
+  }
+#ifdef __SSE2__
+  for (i = 0; i < 4; i++) {
+    __m128i c = _mm_loadu_si128((const __m128i *)(row + x + 16 * i));
+    v |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_slli_epi16(c, 7)) << (16 * i);
+  }
+#else
+  /* the multiply gathers the low bit of each byte into the top byte */
+  for (i = 0; i < 8; i++) {
+    uint64_t b;
+
+    memcpy(&b, row + x + 8 * i, 8);
+    v |= ((b * 0x0102040810204080ull) >> 56) << (8 * i);
+  }
+#endif
+  return v;
+} /* word */
+
+/*
+ * scalar_rows:
+ *  Portable kernel.  The 3x3 neighbourhood index slides along the row
+ *  one column at a time, so each cell costs a shift, an or and a table
+ *  lookup.  B3/S23 keeps a branch-free form the compiler vectorizes:
+ *  n | c == 3 holds exactly when n == 3, or n == 2 and the cell is
+ *  alive.
+ *
+ */
+static void
+scalar_rows(const unsigned char *src, unsigned char *dst,
+            int w, int stride, int y0, int y1)
+{
+  int x, y;
+  unsigned idx;
+
+  for (y = y0; y < y1; y++) {
+    const unsigned char *up = src + (y - 1) * stride;
+    const unsigned char *mid = src + y * stride;
+    const unsigned char *down = src + (y + 1) * stride;
+    unsigned char *out = dst + y * stride;
+
+    if (life) {
+      for (x = 0; x < w; x++) {
+        unsigned n = up[x - 1] + up[x] + up[x + 1]
+                   + mid[x - 1] + mid[x + 1]
+                   + down[x - 1] + down[x] + down[x + 1];
+        out[x] = (n | mid[x]) == 3;
+      }
+      continue;
+    }
+#define COL(x) (up[x] | mid[x] << 1 | down[x] << 2)
+    idx = COL(-1) << 3 | COL(0);
+    for (x = 0; x < w; x++) {
+      idx = ((idx << 3) | COL(x + 1)) & 0x1ff;
+      out[x] = rule.table[idx];
+    }
+#undef COL
+  }
+} /* scalar_rows */
+
+#ifdef GRID_X86
+/*
+ * sse2_rows:
+ *  16 cells per iteration.  The eight neighbours are added bytewise,
+ *  then compared against each count in the rule.
+ *
+ */
+__attribute__((target("sse2")))
+static void
+sse2_rows(const unsigned char *src, unsigned char *dst,
+          int w, int stride, int y0, int y1)
+{
+  int i, x, y;
+  const __m128i one = _mm_set1_epi8(1), zero = _mm_setzero_si128();
+
+#define LD(p) _mm_loadu_si128((const __m128i *)(p))
+  for (y = y0; y < y1; y++) {
+    const unsigned char *up = src + (y - 1) * stride;
+    const unsigned char *mid = src + y * stride;
+    const unsigned char *down = src + (y + 1) * stride;
+    unsigned char *out = dst + y * stride;
+
+    for (x = 0; x + 16 <= w; x += 16) {
+      __m128i live = _mm_cmpgt_epi8(LD(mid + x), zero);
+      __m128i n = _mm_add_epi8(
+        _mm_add_epi8(_mm_add_epi8(LD(up + x - 1), LD(up + x)),
+                     _mm_add_epi8(LD(up + x + 1), LD(mid + x - 1))),
+        _mm_add_epi8(_mm_add_epi8(LD(mid + x + 1), LD(down + x - 1)),
+                     _mm_add_epi8(LD(down + x), LD(down + x + 1))));
+      __m128i born = zero, stay = zero;
+
+      for (i = 0; i < nborn; i++)
+        born = _mm_or_si128(born, _mm_cmpeq_epi8(n, _mm_set1_epi8(born_n[i])));
+      for (i = 0; i < nstay; i++)
+        stay = _mm_or_si128(stay, _mm_cmpeq_epi8(n, _mm_set1_epi8(stay_n[i])));
+      _mm_storeu_si128((__m128i *)(out + x),
+                       _mm_and_si128(_mm_or_si128(_mm_andnot_si128(live, born),
+                                                  _mm_and_si128(live, stay)),
+                                     one));
+    }
+    if (x < w)
+      scalar_rows(src + x, dst + x, w - x, stride, y, y + 1);
+  }
+#undef LD
+} /* sse2_rows */
+
+/*
+ * avx2_step:
+ *  32 cells per iteration.  The neighbour count indexes the birth and
+ *  survival tables with a byte shuffle, and live cells take the
+ *  survival result through a blend.  Unless bits is NULL, each row is
+ *  also packed into it, nwords a row, from the masks of the cells as
+ *  they are stored.
+ *
+ */
+__attribute__((target("avx2"), always_inline))
+static inline void
+avx2_step(const unsigned char *src, unsigned char *dst,
+          int w, int stride, int y0, int y1, uint64_t *bits)
+{
+  int x, y, nwords = (w + 63) / 64;
+  uint64_t *row = NULL;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i btbl = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i *)born_tbl));
+  const __m256i stbl = _mm256_broadcastsi128_si256(
+    _mm_loadu_si128((const __m128i *)stay_tbl));
+
+#define LD(p) _mm256_loadu_si256((const __m256i *)(p))
+  for (y = y0; y < y1; y++) {
+    const unsigned char *up = src + (y - 1) * stride;
+    const unsigned char *mid = src + y * stride;
+    const unsigned char *down = src + (y + 1) * stride;
+    unsigned char *out = dst + y * stride;
+
+    if (bits != NULL)
+      row = bits + (size_t)y * nwords;
+    for (x = 0; x + 32 <= w; x += 32) {
+      __m256i c = LD(mid + x);
+      __m256i col = _mm256_add_epi8(_mm256_add_epi8(LD(up + x), LD(mid + x)),
+                                    LD(down + x));
+      __m256i n = _mm256_add_epi8(
+        _mm256_add_epi8(
+          _mm256_add_epi8(LD(up + x - 1), LD(mid + x - 1)),
+          _mm256_add_epi8(LD(down + x - 1), LD(up + x + 1))),
+        _mm256_add_epi8(_mm256_add_epi8(LD(mid + x + 1), LD(down + x + 1)),
+                        _mm256_sub_epi8(col, c)));
+      __m256i born = _mm256_shuffle_epi8(btbl, n);
+      __m256i stay = _mm256_shuffle_epi8(stbl, n);
+      __m256i live = _mm256_cmpgt_epi8(c, zero);
+      __m256i next = _mm256_blendv_epi8(born, stay, live);
+
+      _mm256_storeu_si256((__m256i *)(out + x), next);
+      if (bits != NULL) {
+        uint64_t m = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(next, 7));
+
+        if (x & 32)
+          row[x / 64] |= m << 32;
+        else
+          row[x / 64] = m;
+      }
+    }
+    if (x < w) {
+      sse2_rows(src + x, dst + x, w - x, stride, y, y + 1);
+      if (bits != NULL)
+        row[x / 64] = word(out, x & ~63, w);
+    }
+  }
+#undef LD
+} /* avx2_step */
+
+__attribute__((target("avx2")))
+static void
+avx2_rows(const unsigned char *src, unsigned char *dst,
+          int w, int stride, int y0, int y1)
+{
+  avx2_step(src, dst, w, stride, y0, y1, NULL);
+} /* avx2_rows */
+
+__attribute__((target("avx2")))
+static void
+avx2_packed(const unsigned char *src, unsigned char *dst,
+            int w, int stride, int y0, int y1, uint64_t *bits)
+{
+  avx2_step(src, dst, w, stride, y0, y1, bits);
+} /* avx2_packed */
+#endif
+
+/*
+ * grid_rule_init:
+ *  Makes the kernels apply r, or B3/S23 if r is NULL.  Call it before
+ *  any grid is evolved, not while one is.
+ *
+ */
+void
+grid_rule_init(const struct rule *r)
+{
+  int n;
+
+  if (r != NULL)
+    rule = *r;
+  else
+    rule_life(&rule);
+  nborn = nstay = 0;
+  for (n = 0; n <= 8; n++) {
+    born_tbl[n] = (rule.birth >> n) & 1;
+    stay_tbl[n] = (rule.survive >> n) & 1;
+    if (born_tbl[n])
+      born_n[nborn++] = n;
+    if (stay_tbl[n])
+      stay_n[nstay++] = n;
+  }
+  life = rule_is_life(&rule);
+  have_rule = 1;
+} /* grid_rule_init */
+
+/*
+ * grid_rule:
+ *  The rule the kernels apply
+ *
+ */
+const struct rule *
+grid_rule(void)
+{
+  if (!have_rule)
+    grid_rule_init(NULL);
+  return &rule;
+} /* grid_rule */
+
+/* a kernel that also packs the rows it writes, as evolve_grid_packed */
+typedef void (*packed_t)(const unsigned char *src, unsigned char *dst,
+                         int w, int stride, int y0, int y1, uint64_t *bits);
+
+static const struct {
+  const char *name;
+  grid_kernel_t fn;
+  packed_t packed;              /* NULL: the rows are packed after */
+} kernels[] = {
+#ifdef GRID_X86
+  { "avx2", avx2_rows, avx2_packed },
+  { "sse2", sse2_rows, NULL },
+#endif
+  { "scalar", scalar_rows, NULL },
+};
+
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static grid_kernel_t kernel = scalar_rows;
+static packed_t packed;
+
+/*
+ * supported:
+ *  Whether the CPU we are running on can execute kernel i
+ *
+ */
+static int
+supported(int i)
+{
+#ifdef GRID_X86
+  __builtin_cpu_init();
+  if (kernels[i].fn == avx2_rows)
+    return __builtin_cpu_supports("avx2");
+  if (kernels[i].fn == sse2_rows)
+    return __builtin_cpu_supports("sse2");
+#endif
+  return kernels[i].fn == scalar_rows;
+} /* supported */
+
+/*
+ * grid_kernel_init:
+ *  Selects the kernel used by evolve_grid.  With a NULL name the
+ *  widest one the CPU supports is picked.  Returns the name of the
+ *  kernel in use, or NULL if the one asked for is unknown or not
+ *  supported here (the previous choice is then kept).  The rule is
+ *  B3/S23 until grid_rule_init says otherwise.
+ *
+ */
+const char *
+grid_kernel_init(const char *name)
+{
+  int i;
+
+  if (!have_rule)
+    grid_rule_init(NULL);
+  for (i = 0; i < NKERNELS; i++) {
+    if (name != NULL && strcmp(name, kernels[i].name) != 0)
+      continue;
+    if (!supported(i))
+      continue;
+    kernel = kernels[i].fn;
+    packed = kernels[i].packed;
+    return kernels[i].name;
+  }
+  return NULL;
+} /* grid_kernel_init */
+
+/*
+ * evolve_grid_rows:
+ *  Writes rows [y0, y1) of the generation after src into dst
+ *
+ */
+void
+evolve_grid_rows(const unsigned char *src, unsigned char *dst,
+                 int w, int stride, int y0, int y1)
+{
+  kernel(src, dst, w, stride, y0, y1);
+} /* evolve_grid_rows */
+
+/*
+ * evolve_grid_packed:
+ *  As evolve_grid_rows, and packs each row written into bits, 64
+ *  cells a word and (w + 63) / 64 words a row, row y at the same place
+ *  as in grid_hash.  Kernels that can pack the cells as they store
+ *  them do; for the others the rows are packed while still in cache.
+ *
+ */
+void
+evolve_grid_packed(const unsigned char *src, unsigned char *dst,
+                   int w, int stride, int y0, int y1, uint64_t *bits)
+{
+  int x, y, nwords = (w + 63) / 64;
+
+  if (packed != NULL) {
+    packed(src, dst, w, stride, y0, y1, bits);
+    return;
+  }
+  kernel(src, dst, w, stride, y0, y1);
+  for (y = y0; y < y1; y++)
+    for (x = 0; x < w; x += 64)
+      bits[(size_t)y * nwords + x / 64] = word(dst + y * stride, x, w);
+} /* evolve_grid_packed */
+
+/*
+ * evolve_grid:
+ *  Writes the generation after src into dst; the two must not overlap
+ *
+ */
+void
+evolve_grid(const unsigned char *src, unsigned char *dst,
+            int w, int h, int stride)
+{
+  kernel(src, dst, w, stride, 0, h);
+} /* evolve_grid */
+
+/*
+ * grid_checksum:
+ *  64-bit FNV-1a hash of the cells of g, row by row, ghosts excluded.
+ *  Equal boards give equal checksums whatever engine produced them.
+ *
+ */
+uint64_t
+grid_checksum(const unsigned char *g, int w, int h, int stride)
+{
+  return grid_checksum_more(0xcbf29ce484222325ull, g, w, h, stride);
+} /* grid_checksum */
+
+/*
+ * grid_checksum_more:
+ *  Carries checksum sum on over the rows of g, so that a board kept in
+ *  bands hashes as if it were one grid
+ *
+ */
+uint64_t
+grid_checksum_more(uint64_t sum, const unsigned char *g, int w, int h,
+                   int stride)
+{
+  int x, y;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++) {
+      sum ^= g[y * stride + x] != 0;
+      sum *= 0x100000001b3ull;
+    }
+  return sum;
+} /* grid_checksum_more */
+
+/*
+ * grid_population:
+ *  Live cells of g
+ *
+ */
+uint64_t
+grid_population(const unsigned char *g, int w, int h, int stride)
+{
+  uint64_t n = 0;
+  int x, y;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+      n += g[(size_t)y * stride + x];
+  return n;
+} /* grid_population */
+
+/*
+ * The position hash of a board is the sum of one 64-bit value per
+ * word of 64 cells, the cells packed to bits and mixed with a key for
+ * where the word lies.  Being a sum, it is kept up to date by adding
+ * the new value of each word that changed and subtracting the one it
+ * had.  Both the value and the cells of each word are kept, so a word
+ * whose cells are as they were is passed over with one compare, and
+ * only words that changed are mixed again.  Words start at every 64th
+ * column, and coordinates are shifted by dx, dy first so that a board
+ * that grew can keep hashing the same cells the same.
+ *
+ */
+#define KEY_X 0x9e3779b97f4a7c15ull
+#define KEY_Y 0xc2b2ae3d27d4eb4full
+
+static inline uint64_t
+mix(uint64_t v, uint64_t key)
+{
+  uint64_t z = v + key;
+
+  z ^= z >> 32;
+  z *= 0xd6e8feb86659fd93ull;
+  z ^= z >> 29;
+  z *= 0x94d049bb133111ebull;
+  return z ^ (z >> 32);
+} /* mix */
+
+/*
+ * rehash:
+ *  Makes v the cells of word i of row y; what that adds to the sum
+ *
+ */
+static inline uint64_t
+rehash(struct grid_hash *hs, int i, int y, uint64_t v)
+{
+  size_t at = (size_t)y * hs->nwords + i;
+  uint64_t m;
+
+  if (v == hs->bits[at])
+    return 0;
+  hs->bits[at] = v;
+  m = mix(v, (uint64_t)(64 * i + hs->dx) * KEY_X
+             + (uint64_t)(y + hs->dy) * KEY_Y);
+  v = m - hs->words[at];
+  hs->words[at] = m;
+  return v;
+} /* rehash */
+
+/*
+ * grid_hash_init:
+ *  Hashes g from scratch into hs, keeping the value and cells of
+ *  every word; -1 if out of memory
+ *
+ */
+int
+grid_hash_init(struct grid_hash *hs, const unsigned char *g,
+               int w, int h, int stride, int dx, int dy)
+{
+  int x, y;
+  size_t i = 0, n = (size_t)((w + 63) / 64) * h;
+  uint64_t *words = realloc(hs->words, 3 * n * sizeof(uint64_t));
+
+  if (words == NULL)
+    return -1;
+  hs->words = words;
+  hs->bits = words + n;
+  hs->next = words + 2 * n;
+  hs->nwords = (w + 63) / 64;
+  hs->dx = dx;
+  hs->dy = dy;
+  hs->sum = 0;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x += 64, i++) {
+      hs->bits[i] = word(g + y * stride, x, w);
+      words[i] = mix(hs->bits[i],
+                     (uint64_t)(x + dx) * KEY_X + (uint64_t)(y + dy) * KEY_Y);
+      hs->sum += words[i];
+    }
+  return 0;
+} /* grid_hash_init */
+
+void
+grid_hash_free(struct grid_hash *hs)
+{
+  free(hs->words);
+  hs->words = hs->bits = hs->next = NULL;
+} /* grid_hash_free */
+
+/*
+ * grid_hash_rows:
+ *  Rehashes the words of g that hold columns [x0, x1) of rows
+ *  [y0, y1), and returns what that adds to hs->sum.  The caller adds
+ *  it, so bands of rows can be rehashed on different threads.
+ *
+ */
+uint64_t
+grid_hash_rows(struct grid_hash *hs, const unsigned char *g, int w,
+               int stride, int x0, int x1, int y0, int y1)
+{
+  int x, y;
+  uint64_t sum = 0;
+
+  for (y = y0; y < y1; y++)
+    for (x = x0 & ~63; x < x1; x += 64)
+      sum += rehash(hs, x / 64, y, word(g + y * stride, x, w));
+  return sum;
+} /* grid_hash_rows */
+
+/*
+ * grid_hash_next:
+ *  As grid_hash_rows, for all of rows [y0, y1) as evolve_grid_packed
+ *  left them in hs->next.  In a busy soup about half of the words
+ *  change each generation, too many to branch on one by one, so the
+ *  words that changed are gathered into a mask first, 64 at a time,
+ *  and only those are visited.
+ *
+ */
+uint64_t
+grid_hash_next(struct grid_hash *hs, int y0, int y1)
+{
+  int i, j, n, y;
+  uint64_t changed, m, sum = 0;
+
+  for (y = y0; y < y1; y++) {
+    size_t at = (size_t)y * hs->nwords;
+    const uint64_t *next = hs->next + at;
+    uint64_t *bits = hs->bits + at, *words = hs->words + at;
+    uint64_t ky = (uint64_t)(y + hs->dy) * KEY_Y;
+
+    for (i = 0; i < hs->nwords; i += 64) {
+      n = hs->nwords - i < 64 ? hs->nwords - i : 64;
+      changed = 0;
+      for (j = 0; j < n; j++)
+        changed |= (uint64_t)(next[i + j] != bits[i + j]) << j;
+      for (; changed != 0; changed &= changed - 1) {
+        j = i + __builtin_ctzll(changed);
+        bits[j] = next[j];
+        m = mix(next[j], (uint64_t)(64 * j + hs->dx) * KEY_X + ky);
+        sum += m - words[j];
+        words[j] = m;
+      }
+    }
+  }
+  return sum;
+} /* grid_hash_next */
@@ -0,0 +1,60 @@
+#ifndef __GRID_H
+#define __GRID_H
+#include <stdint.h>
+
+/*
+ * A grid stores one cell per byte, 0 dead and 1 alive.  A grid pointer
+ * g refers to cell (0, 0); cell (x, y) is g[y * stride + x].  Every
+ * grid is surrounded by a border of ghost cells (x == -1, x == w,
+ * y == -1, y == h) that the kernels read but never write, so the inner
+ * loops need no bounds checks.  The ghosts are dead unless a topology
+ * fills them in.  Rows are padded to whole cache lines, so stride is
+ * at least w + 2 and often more.
+ *
+ */
+int grid_new_n(int w, int h, int n, unsigned char **g, int *stride);
+unsigned char *grid_new(int w, int h, int *stride);
+int grid_stride(int w);
+void grid_free(unsigned char *g, int stride);
+int grid_pages(const unsigned char *g, long *size, long *page, long *huge);
+void grid_wrap(unsigned char *g, int w, int h, int stride);
+
+typedef void (*grid_kernel_t)(const unsigned char *src, unsigned char *dst,
+                              int w, int stride, int y0, int y1);
+
+struct rule;
+
+const char *grid_kernel_init(const char *name);
+void grid_rule_init(const struct rule *r);
+const struct rule *grid_rule(void);
+void evolve_grid_rows(const unsigned char *src, unsigned char *dst,
+                      int w, int stride, int y0, int y1);
+void evolve_grid_packed(const unsigned char *src, unsigned char *dst,
+                        int w, int stride, int y0, int y1, uint64_t *bits);
+void evolve_grid(const unsigned char *src, unsigned char *dst,
+                 int w, int h, int stride);
+uint64_t grid_checksum(const unsigned char *g, int w, int h, int stride);
+uint64_t grid_checksum_more(uint64_t sum, const unsigned char *g, int w, int h,
+                            int stride);
+uint64_t grid_population(const unsigned char *g, int w, int h, int stride);
+
+/*
+ * A position hash kept up to date as the grid evolves; see grid.c
+ *
+ */
+struct grid_hash {
+  uint64_t sum;                 /* the hash */
+  uint64_t *words;              /* value of each word of 64 cells */
+  uint64_t *bits;               /* ... and its cells, packed */
+  uint64_t *next;               /* rows packed by evolve_grid_packed */
+  int nwords;                   /* words per row */
+  int dx, dy;                   /* added to coordinates before hashing */
+};
+
+int grid_hash_init(struct grid_hash *hs, const unsigned char *g,
+                   int w, int h, int stride, int dx, int dy);
+void grid_hash_free(struct grid_hash *hs);
+uint64_t grid_hash_rows(struct grid_hash *hs, const unsigned char *g,
+                        int w, int stride, int x0, int x1, int y0, int y1);
+uint64_t grid_hash_next(struct grid_hash *hs, int y0, int y1);
+#endif
@@ -0,0 +1,625 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         hashlife.c
+* Description:  Hashlife: memoised quadtree evolution
+*
+*******************************************************************************
+*/
+
+/*
+ * A node of level k is a 2^k square made of four level k - 1 nodes.
+ * Level 0 nodes are single cells.  Nodes live in one array and refer
+ * to each other by index, so the array can grow while we recurse;
+ * never keep a struct node pointer across a call that creates nodes.
+ *
+ * The RESULT of a level k node is the level k - 1 square at its centre
+ * 2^min(j, k - 2) generations later, where 2^j is the step in use.  It
+ * is memoised in the node.
+ *
+ * Every node carries the epoch (step number) in which it was last
+ * used.  When the node count goes over the memory cap, nodes not
+ * reachable from the universe and not used during the last step are
+ * evicted, and memoised results pointing at them are forgotten.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hashlife.h"
+#include "rule.h"
+
+#define NIL   0
+#define DEAD  1
+#define ALIVE 2
+#define FIRST 3                 /* first index of a hash-consed node */
+
+#define MAXLEVEL 62
+#define FREE     0xff           /* level of a slot on the free list */
+
+struct node {
+  uint32_t nw, ne, sw, se;
+  uint32_t result;
+  uint32_t next;                /* hash chain or free list */
+  uint32_t stamp;
+  uint32_t level;
+  uint64_t pop;
+};
+
+struct hashlife {
+  struct node *nodes;
+  uint32_t used;                /* slots ever handed out */
+  uint32_t size;                /* slots allocated */
+  uint32_t live;                /* slots holding a node */
+  uint32_t free;
+  uint32_t limit;               /* node budget from the memory cap */
+  uint32_t *buckets;
+  uint32_t nbuckets;            /* a power of two */
+  uint32_t empty[MAXLEVEL + 1];
+  uint32_t root;
+  int step;                     /* log2 of the memoised step, -1 if none */
+  uint32_t epoch;
+  uint64_t gen;
+  int ox, oy;                   /* plane coordinates of board cell (0, 0) */
+  struct rule rule;
+};
+
+#define N(i) (hl->nodes[i])
+
+static uint32_t
+hash(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+  uint64_t h = nw * 0x9e3779b97f4a7c15ull;
+  h = (h ^ ne) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ sw) * 0x94d049bb133111ebull;
+  h = (h ^ se) * 0x9e3779b97f4a7c15ull;
+  return (uint32_t)(h >> 32);
+} /* hash */
+
+/*
+ * rehash:
+ *  Rebuilds the hash chains into nbuckets buckets
+ *
+ */
+static int
+rehash(struct hashlife *hl, uint32_t nbuckets)
+{
+  uint32_t i, b;
+  uint32_t *buckets = calloc(nbuckets, sizeof(uint32_t));
+
+  if (buckets == NULL)
+    return -1;
+  free(hl->buckets);
+  hl->buckets = buckets;
+  hl->nbuckets = nbuckets;
+  for (i = FIRST; i < hl->used; i++) {
+    if (N(i).level == FREE)
+      continue;
+    b = hash(N(i).nw, N(i).ne, N(i).sw, N(i).se) & (nbuckets - 1);
+    N(i).next = buckets[b];
+    buckets[b] = i;
+  }
+  return 0;
+} /* rehash */
+
+/*
+ * node_alloc:
+ *  Returns a free slot, growing the array if needed.  Out of memory
+ *  is fatal in the middle of a recursion, so we give up there.
+ *
+ */
+static uint32_t
+node_alloc(struct hashlife *hl)
+{
+  uint32_t i;
+
+  if (hl->free != NIL) {
+    i = hl->free;
+    hl->free = N(i).next;
+  } else {
+    if (hl->used == hl->size) {
+      struct node *nodes;
+      uint32_t size = hl->size * 2;
+
+      nodes = realloc(hl->nodes, (size_t)size * sizeof(struct node));
+      if (nodes == NULL || size < hl->size)
+        abort();
+      hl->nodes = nodes;
+      hl->size = size;
+    }
+    i = hl->used++;
+  }
+  hl->live++;
+  return i;
+} /* node_alloc */
+
+/*
+ * join:
+ *  The canonical node with the given quadrants
+ *
+ */
+static uint32_t
+join(struct hashlife *hl, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+  uint32_t h = hash(nw, ne, sw, se), i;
+
+  for (i = hl->buckets[h & (hl->nbuckets - 1)]; i != NIL; i = N(i).next) {
+    if (N(i).nw == nw && N(i).ne == ne && N(i).sw == sw && N(i).se == se) {
+      N(i).stamp = hl->epoch;
+      return i;
+    }
+  }
+  if (hl->live >= hl->nbuckets && rehash(hl, hl->nbuckets * 2) != 0)
+    abort();
+  i = node_alloc(hl);
+  N(i).nw = nw;
+  N(i).ne = ne;
+  N(i).sw = sw;
+  N(i).se = se;
+  N(i).result = NIL;
+  N(i).stamp = hl->epoch;
+  N(i).level = N(nw).level + 1;
+  N(i).pop = N(nw).pop + N(ne).pop + N(sw).pop + N(se).pop;
+  h &= hl->nbuckets - 1;
+  N(i).next = hl->buckets[h];
+  hl->buckets[h] = i;
+  return i;
+} /* join */
+
+static uint32_t
+empty(struct hashlife *hl, uint32_t level)
+{
+  uint32_t e;
+
+  if (hl->empty[level] == NIL) {
+    e = empty(hl, level - 1);
+    hl->empty[level] = join(hl, e, e, e, e);
+  }
+  return hl->empty[level];
+} /* empty */
+
+/* the level k - 1 square at the centre of i, and between two nodes */
+static uint32_t
+centre(struct hashlife *hl, uint32_t i)
+{
+  return join(hl, N(N(i).nw).se, N(N(i).ne).sw, N(N(i).sw).ne, N(N(i).se).nw);
+} /* centre */
+
+static uint32_t
+centre_h(struct hashlife *hl, uint32_t w, uint32_t e)
+{
+  return join(hl, N(w).ne, N(e).nw, N(w).se, N(e).sw);
+} /* centre_h */
+
+static uint32_t
+centre_v(struct hashlife *hl, uint32_t n, uint32_t s)
+{
+  return join(hl, N(n).sw, N(n).se, N(s).nw, N(s).ne);
+} /* centre_v */
+
+/*
+ * base:
+ *  RESULT of a level 2 node: the centre 2x2 one generation later
+ *
+ */
+static uint32_t
+base(struct hashlife *hl, uint32_t i)
+{
+  int x, y, c[4][4], r[4];
+  uint32_t q[4] = { N(i).nw, N(i).ne, N(i).sw, N(i).se };
+
+  for (y = 0; y < 4; y++)
+    for (x = 0; x < 4; x++) {
+      struct node *n = &N(q[(y / 2) * 2 + x / 2]);
+      uint32_t leaf = (y % 2 ? (x % 2 ? n->se : n->sw)
+                             : (x % 2 ? n->ne : n->nw));
+      c[y][x] = leaf == ALIVE;
+    }
+#define COLUMN(x, y) (c[(y) - 1][x] | c[y][x] << 1 | c[(y) + 1][x] << 2)
+  for (y = 1; y < 3; y++)
+    for (x = 1; x < 3; x++)
+      r[(y - 1) * 2 + x - 1] =
+        hl->rule.table[RULE_INDEX(COLUMN(x - 1, y), COLUMN(x, y),
+                                  COLUMN(x + 1, y))] ? ALIVE : DEAD;
+#undef COLUMN
+  return join(hl, r[0], r[1], r[2], r[3]);
+} /* base */
+
+/*
+ * successor:
+ *  RESULT of node i for a step of 2^j generations
+ *
+ */
+static uint32_t
+successor(struct hashlife *hl, uint32_t i, int j)
+{
+  uint32_t k = N(i).level, r;
+  uint32_t nw, ne, sw, se, m[3][3], s[3][3];
+  int x, y, fast = j >= (int)k - 2;
+
+  if (N(i).pop == 0)
+    return empty(hl, k - 1);
+  if (N(i).result != NIL) {
+    N(N(i).result).stamp = hl->epoch;
+    return N(i).result;
+  }
+  if (k == 2) {
+    r = base(hl, i);
+  } else {
+    nw = N(i).nw;
+    ne = N(i).ne;
+    sw = N(i).sw;
+    se = N(i).se;
+    /* nine overlapping level k - 1 squares */
+    m[0][0] = nw;
+    m[0][1] = centre_h(hl, nw, ne);
+    m[0][2] = ne;
+    m[1][0] = centre_v(hl, nw, sw);
+    m[1][1] = centre(hl, i);
+    m[1][2] = centre_v(hl, ne, se);
+    m[2][0] = sw;
+    m[2][1] = centre_h(hl, sw, se);
+    m[2][2] = se;
+    /* at full speed both halves advance, otherwise only the second */
+    for (y = 0; y < 3; y++)
+      for (x = 0; x < 3; x++)
+        s[y][x] = fast ? successor(hl, m[y][x], j) : centre(hl, m[y][x]);
+    nw = successor(hl, join(hl, s[0][0], s[0][1], s[1][0], s[1][1]), j);
+    ne = successor(hl, join(hl, s[0][1], s[0][2], s[1][1], s[1][2]), j);
+    sw = successor(hl, join(hl, s[1][0], s[1][1], s[2][0], s[2][1]), j);
+    se = successor(hl, join(hl, s[1][1], s[1][2], s[2][1], s[2][2]), j);
+    r = join(hl, nw, ne, sw, se);
+  }
+  N(i).result = r;
+  return r;
+} /* successor */
+
+/*
+ * expand:
+ *  The node one level up with i at its centre
+ *
+ */
+static uint32_t
+expand(struct hashlife *hl, uint32_t i)
+{
+  uint32_t e = empty(hl, N(i).level - 1);
+  uint32_t nw = N(i).nw, ne = N(i).ne, sw = N(i).sw, se = N(i).se;
+
+  nw = join(hl, e, e, e, nw);
+  ne = join(hl, e, e, ne, e);
+  sw = join(hl, e, sw, e, e);
+  se = join(hl, se, e, e, e);
+  return join(hl, nw, ne, sw, se);
+} /* expand */
+
+/*
+ * inner_pop:
+ *  Population of the level k - 2 square at the centre of i
+ *
+ */
+static uint64_t
+inner_pop(const struct hashlife *hl, uint32_t i)
+{
+  return N(N(N(N(i).nw).se).se).pop + N(N(N(N(i).ne).sw).sw).pop
+    + N(N(N(N(i).sw).ne).ne).pop + N(N(N(N(i).se).nw).nw).pop;
+} /* inner_pop */
+
+static void
+mark(const struct hashlife *hl, unsigned char *marks, uint32_t i)
+{
+  if (marks[i])
+    return;
+  marks[i] = 1;
+  if (N(i).level > 0) {
+    mark(hl, marks, N(i).nw);
+    mark(hl, marks, N(i).ne);
+    mark(hl, marks, N(i).sw);
+    mark(hl, marks, N(i).se);
+  }
+} /* mark */
+
+/*
+ * collect:
+ *  Evicts the nodes that are neither part of the universe nor, unless
+ *  full is set, used during the current epoch
+ *
+ */
+static void
+collect(struct hashlife *hl, int full)
+{
+  uint32_t i, k;
+  unsigned char *marks = calloc(hl->used, 1);
+
+  if (marks == NULL)
+    return;
+  marks[NIL] = marks[DEAD] = marks[ALIVE] = 1;
+  mark(hl, marks, hl->root);
+  for (k = 0; k <= MAXLEVEL; k++)
+    if (hl->empty[k] != NIL)
+      mark(hl, marks, hl->empty[k]);
+  for (i = FIRST; i < hl->used && !full; i++)
+    if (N(i).level != FREE && N(i).stamp == hl->epoch)
+      mark(hl, marks, i);
+
+  for (i = FIRST; i < hl->used; i++) {
+    if (N(i).level == FREE)
+      continue;
+    if (!marks[i]) {
+      N(i).level = FREE;
+      N(i).next = hl->free;
+      hl->free = i;
+      hl->live--;
+    } else if (!marks[N(i).result]) {
+      N(i).result = NIL;
+    }
+  }
+  free(marks);
+  rehash(hl, hl->nbuckets);
+} /* collect */
+
+/*
+ * hl_new:
+ *  An empty universe whose node store is kept within about maxmem
+ *  bytes between steps; NULL if out of memory
+ *
+ */
+struct hashlife *
+hl_new(size_t maxmem)
+{
+  struct hashlife *hl = calloc(1, sizeof(*hl));
+  size_t limit = maxmem / (sizeof(struct node) + sizeof(uint32_t) + 1);
+
+  if (hl == NULL)
+    return NULL;
+  hl->limit = limit > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t)limit;
+  hl->size = 1 << 16;
+  hl->nodes = calloc(hl->size, sizeof(struct node));
+  if (hl->nodes == NULL || rehash(hl, 1 << 16) != 0) {
+    hl_free(hl);
+    return NULL;
+  }
+  hl->used = FIRST;
+  hl->nodes[ALIVE].pop = 1;
+  hl->empty[0] = DEAD;
+  hl->root = empty(hl, 3);
+  hl->step = -1;
+  rule_life(&hl->rule);
+  return hl;
+} /* hl_new */
+
+void
+hl_free(struct hashlife *hl)
+{
+  if (hl == NULL)
+    return;
+  free(hl->nodes);
+  free(hl->buckets);
+  free(hl);
+} /* hl_free */
+
+/*
+ * build:
+ *  The level k node whose top left corner is board cell (x0, y0)
+ *
+ */
+static uint32_t
+build(struct hashlife *hl, const unsigned char *g, int w, int h, int stride,
+      uint32_t k, int64_t x0, int64_t y0)
+{
+  int64_t size = (int64_t)1 << k, half = size / 2;
+  uint32_t nw, ne, sw, se;
+
+  if (x0 >= w || y0 >= h || x0 + size <= 0 || y0 + size <= 0)
+    return empty(hl, k);
+  if (k == 0)
+    return g[y0 * stride + x0] ? ALIVE : DEAD;
+  nw = build(hl, g, w, h, stride, k - 1, x0, y0);
+  ne = build(hl, g, w, h, stride, k - 1, x0 + half, y0);
+  sw = build(hl, g, w, h, stride, k - 1, x0, y0 + half);
+  se = build(hl, g, w, h, stride, k - 1, x0 + half, y0 + half);
+  return join(hl, nw, ne, sw, se);
+} /* build */
+
+/*
+ * hl_load:
+ *  Replaces the universe with the w-by-h grid g, centred on the
+ *  origin, and resets the generation count; -1 if it is too large
+ *
+ */
+int
+hl_load(struct hashlife *hl, const unsigned char *g, int w, int h, int stride)
+{
+  uint32_t k = 3;
+
+  while (((int64_t)1 << (k - 1)) < (w > h ? w : h))
+    if (++k > MAXLEVEL)
+      return -1;
+  hl->ox = w / 2;
+  hl->oy = h / 2;
+  hl->root = build(hl, g, w, h, stride, k,
+                   hl->ox - ((int64_t)1 << (k - 1)),
+                   hl->oy - ((int64_t)1 << (k - 1)));
+  hl->gen = 0;
+  return 0;
+} /* hl_load */
+
+static void
+paint(const struct hashlife *hl, uint32_t i, unsigned char *g,
+      int w, int h, int stride, int64_t x0, int64_t y0)
+{
+  int64_t size = (int64_t)1 << N(i).level, half = size / 2;
+
+  if (N(i).pop == 0 || x0 >= w || y0 >= h || x0 + size <= 0 || y0 + size <= 0)
+    return;
+  if (N(i).level == 0) {
+    g[y0 * stride + x0] = 1;
+    return;
+  }
+  paint(hl, N(i).nw, g, w, h, stride, x0, y0);
+  paint(hl, N(i).ne, g, w, h, stride, x0 + half, y0);
+  paint(hl, N(i).sw, g, w, h, stride, x0, y0 + half);
+  paint(hl, N(i).se, g, w, h, stride, x0 + half, y0 + half);
+} /* paint */
+
+/*
+ * hl_store_at:
+ *  Writes the w-by-h window of the universe whose top left corner is
+ *  cell (x0, y0) of the board hl_load read into g
+ *
+ */
+void
+hl_store_at(const struct hashlife *hl, unsigned char *g, int w, int h,
+            int stride, int64_t x0, int64_t y0)
+{
+  int y;
+  int64_t half = (int64_t)1 << N(hl->root).level >> 1;
+
+  for (y = 0; y < h; y++)
+    memset(g + y * stride, 0, w);
+  paint(hl, hl->root, g, w, h, stride, hl->ox - half - x0, hl->oy - half - y0);
+} /* hl_store_at */
+
+/*
+ * hl_store:
+ *  Writes the window of the universe that hl_load read back into g
+ *
+ */
+void
+hl_store(const struct hashlife *hl, unsigned char *g, int w, int h, int stride)
+{
+  hl_store_at(hl, g, w, h, stride, 0, 0);
+} /* hl_store */
+
+/*
+ * edge:
+ *  How far from the top left corner of node i, along x (axis 0) or y
+ *  (axis 1), its first live cell lies, or with far its last.  Only the
+ *  half of i nearer the edge sought is searched, unless it is empty.
+ *
+ */
+static int64_t
+edge(const struct hashlife *hl, uint32_t i, int axis, int far)
+{
+  int64_t e, best = -1, half = (int64_t)1 << N(i).level >> 1;
+  uint32_t side[2][2];
+  int k, s, c;
+
+  if (N(i).level == 0)
+    return 0;
+  /* the two children in the near half of the axis, then the far half */
+  side[0][0] = N(i).nw;
+  side[0][1] = axis ? N(i).ne : N(i).sw;
+  side[1][0] = axis ? N(i).sw : N(i).ne;
+  side[1][1] = N(i).se;
+  for (k = 0; k < 2; k++) {
+    s = far ? 1 - k : k;
+    for (c = 0; c < 2; c++)
+      if (N(side[s][c]).pop != 0) {
+        e = edge(hl, side[s][c], axis, far);
+        if (best < 0 || (far ? e > best : e < best))
+          best = e;
+      }
+    if (best >= 0)
+      return best + s * half;
+  }
+  return -1;
+} /* edge */
+
+/*
+ * hl_bounds:
+ *  The smallest box [x0, x1) by [y0, y1), in cells of the board
+ *  hl_load read, that holds every live cell of the universe; -1 if
+ *  there are none
+ *
+ */
+int
+hl_bounds(const struct hashlife *hl, int64_t *x0, int64_t *y0,
+          int64_t *x1, int64_t *y1)
+{
+  int64_t half = (int64_t)1 << N(hl->root).level >> 1;
+
+  if (N(hl->root).pop == 0)
+    return -1;
+  *x0 = hl->ox - half + edge(hl, hl->root, 0, 0);
+  *y0 = hl->oy - half + edge(hl, hl->root, 1, 0);
+  *x1 = hl->ox - half + edge(hl, hl->root, 0, 1) + 1;
+  *y1 = hl->oy - half + edge(hl, hl->root, 1, 1) + 1;
+  return 0;
+} /* hl_bounds */
+
+/*
+ * hl_set_rule:
+ *  Evolves under r from now on.  Every memoised result was for the
+ *  old rule, so all are forgotten.  r must not have B0: the empty
+ *  plane has to stay empty.
+ *
+ */
+void
+hl_set_rule(struct hashlife *hl, const struct rule *r)
+{
+  uint32_t i;
+
+  hl->rule = *r;
+  for (i = FIRST; i < hl->used; i++)
+    if (N(i).level != FREE)
+      N(i).result = NIL;
+  hl->step = -1;
+} /* hl_set_rule */
+
+/*
+ * hl_step:
+ *  Advances the universe by 2^log2gens generations; -1 if the pattern
+ *  has outgrown the largest universe we can address
+ *
+ */
+int
+hl_step(struct hashlife *hl, int log2gens)
+{
+  uint32_t i, keep;
+
+  if (log2gens < 0 || log2gens > MAXLEVEL - 3)
+    return -1;
+  if (log2gens != hl->step) {
+    /* results of levels above keep + 2 were for another step */
+    keep = (uint32_t)(hl->step < log2gens ? hl->step : log2gens) + 2;
+    for (i = FIRST; i < hl->used; i++)
+      if (N(i).level != FREE && (hl->step < 0 || N(i).level > keep))
+        N(i).result = NIL;
+    hl->step = log2gens;
+  }
+  hl->epoch++;
+
+  while (N(hl->root).level < (uint32_t)log2gens + 3
+         || inner_pop(hl, hl->root) != N(hl->root).pop) {
+    if (N(hl->root).level >= MAXLEVEL)
+      return -1;
+    hl->root = expand(hl, hl->root);
+  }
+  hl->root = successor(hl, hl->root, log2gens);
+  hl->gen += (uint64_t)1 << log2gens;
+
+  if (hl->live > hl->limit) {
+    collect(hl, 0);
+    if (hl->live > hl->limit)
+      collect(hl, 1);
+  }
+  return 0;
+} /* hl_step */
+
+uint64_t
+hl_population(const struct hashlife *hl)
+{
+  return N(hl->root).pop;
+} /* hl_population */
+
+uint64_t
+hl_generation(const struct hashlife *hl)
+{
+  return hl->gen;
+} /* hl_generation */
+
+size_t
+hl_nodes(const struct hashlife *hl)
+{
+  return hl->live;
+} /* hl_nodes */
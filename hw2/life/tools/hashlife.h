@@ -0,0 +1,31 @@
+#ifndef __HASHLIFE_H
+#define __HASHLIFE_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hashlife keeps the universe as a quadtree of hash-consed macro-cells
+ * and memoises, for every macro-cell, its centre some power of two
+ * generations later.  Unlike the grid engines it plays on an unbounded
+ * plane: the w-by-h board only picks the window loaded and stored.
+ *
+ */
+struct hashlife;
+struct rule;
+
+struct hashlife *hl_new(size_t maxmem);
+void hl_free(struct hashlife *hl);
+int hl_load(struct hashlife *hl, const unsigned char *g,
+            int w, int h, int stride);
+void hl_store(const struct hashlife *hl, unsigned char *g,
+              int w, int h, int stride);
+void hl_store_at(const struct hashlife *hl, unsigned char *g,
+                 int w, int h, int stride, int64_t x0, int64_t y0);
+int hl_bounds(const struct hashlife *hl, int64_t *x0, int64_t *y0,
+              int64_t *x1, int64_t *y1);
+void hl_set_rule(struct hashlife *hl, const struct rule *r);
+int hl_step(struct hashlife *hl, int log2gens);
+uint64_t hl_population(const struct hashlife *hl);
+uint64_t hl_generation(const struct hashlife *hl);
+size_t hl_nodes(const struct hashlife *hl);
+#endif
@@ -0,0 +1,224 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         jump.c
+* Description:  Many generations at once, by Hashlife or cycle detection
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include "jump.h"
+#include "block.h"
+#include "cycle.h"
+#include "grid.h"
+#include "hashlife.h"
+#include "tiles.h"
+
+#define JUMP_RING       1024    /* states watched for repeats */
+#define JUMP_BLOCK_GENS 8       /* generations per blocked pass */
+#define JUMP_TILE       64      /* tile side on sparse boards */
+#define JUMP_HL_MIN     64      /* shorter jumps on a plane are stepped */
+
+static const char *hows[] = { "steps", "tiles", "blocks", "hashlife" };
+
+/*
+ * jump_new:
+ *  A session that jumps on the threads of p, if it is not NULL, and
+ *  caps Hashlife at hlmem bytes; NULL if out of memory
+ *
+ */
+struct jump *
+jump_new(size_t hlmem, struct pool *p)
+{
+  struct jump *j = calloc(1, sizeof(*j));
+
+  if (j == NULL)
+    return NULL;
+  j->hlmem = hlmem;
+  j->pool = p;
+  j->block_size = block_size(JUMP_BLOCK_GENS);
+  j->rule = *grid_rule();
+  if ((j->cycle = cycle_new(JUMP_RING)) == NULL) {
+    free(j);
+    return NULL;
+  }
+  return j;
+} /* jump_new */
+
+void
+jump_free(struct jump *j)
+{
+  if (j == NULL)
+    return;
+  hl_free(j->hl);
+  block_free(j->block);
+  cycle_free(j->cycle);
+  free(j);
+} /* jump_free */
+
+/*
+ * steps:
+ *  Jumps a board by stepping it, until it repeats or the jump is done.
+ *  Only every JUMP_BLOCK_GENS-th generation is seen in blocks, so the
+ *  period found may be a multiple of the true one, which skips as well.
+ *
+ */
+static int
+steps(struct jump *j, struct board *b, unsigned long long n)
+{
+  int r = 0, k, hashing = b->hashing;
+  uint64_t pop, area = (uint64_t)b->w * b->h;
+  uint64_t cache = 4 * (uint64_t)j->block_size * j->block_size;
+  struct tiles *t = NULL;
+
+  if (!hashing && board_hash_start(b) != 0)
+    return -1;
+  if (b->w != j->w || b->h != j->h || b->topology != j->topology
+      || b->hash.sum != j->hash) {
+    /* not where the last jump left off, so nothing is known about it */
+    cycle_reset(j->cycle);
+    cycle_check(j->cycle, b->hash.sum, j->gen);
+    j->period = 0;
+  }
+
+  pop = grid_population(BOARD_CUR(b), b->w, b->h, b->stride);
+  j->how = JUMP_STEPS;
+  if (b->topology != BOARD_PLANE && pop * 16 >= area && area >= cache)
+    j->how = JUMP_BLOCKS;
+  else if (b->topology != BOARD_PLANE && !(j->rule.birth & 1)
+           && pop * 64 < area)
+    j->how = JUMP_TILES;
+  if (j->how == JUMP_BLOCKS && j->block == NULL
+      && (j->block = block_new(j->block_size, JUMP_BLOCK_GENS,
+                               j->pool != NULL ? pool_threads(j->pool) : 1))
+         == NULL)
+    r = -1;
+  if (j->how == JUMP_TILES && (t = tiles_new(b, JUMP_TILE)) == NULL)
+    r = -1;
+
+  while (r == 0 && n > 0) {
+    if (j->period != 0 && n >= j->period) {
+      n %= j->period;
+      continue;
+    }
+    k = 1;
+    if (j->how == JUMP_BLOCKS && n >= JUMP_BLOCK_GENS) {
+      k = JUMP_BLOCK_GENS;
+      /* a blocked pass leaves the hash behind */
+      r = block_step(j->block, b, j->pool) != 0
+          || board_hash_start(b) != 0 ? -1 : 0;
+    } else if (t != NULL)
+      r = tiles_step(t, b) < 0 ? -1 : 0;
+    else
+      r = board_step(b, j->pool);
+    if (r != 0)
+      break;
+    n -= k;
+    j->gen += k;
+    if (j->period == 0)
+      j->period = cycle_check(j->cycle, b->hash.sum, j->gen);
+  }
+
+  tiles_free(t);
+  j->population = grid_population(BOARD_CUR(b), b->w, b->h, b->stride);
+  j->w = r == 0 ? b->w : 0;
+  j->h = b->h;
+  j->topology = b->topology;
+  j->hash = b->hash.sum;
+  if (!hashing) {
+    grid_hash_free(&b->hash);
+    b->hashing = 0;
+  }
+  return r;
+} /* steps */
+
+/*
+ * macrocells:
+ *  Jumps a board on a plane with Hashlife, by each power of two in n,
+ *  and grows the board to hold all of the universe it comes to; 1 if
+ *  it cannot, leaving b as it was
+ *
+ */
+static int
+macrocells(struct jump *j, struct board *b, unsigned long long n)
+{
+  int k, ox = b->ox, oy = b->oy;
+  int64_t x0, y0, x1, y1;
+
+  if (j->hl == NULL) {
+    if ((j->hl = hl_new(j->hlmem)) == NULL)
+      return -1;
+    hl_set_rule(j->hl, &j->rule);
+  }
+  j->how = JUMP_HASHLIFE;
+  j->w = 0;
+  if (hl_load(j->hl, BOARD_CUR(b), b->w, b->h, b->stride) != 0)
+    goto too_large;
+  for (k = 0; k < 64; k++)
+    if ((n >> k) & 1 && hl_step(j->hl, k) != 0)
+      goto too_large;
+  j->population = hl_population(j->hl);
+
+  if (hl_bounds(j->hl, &x0, &y0, &x1, &y1) == 0) {
+    x0 = x0 < 0 ? -x0 : 0;
+    y0 = y0 < 0 ? -y0 : 0;
+    x1 = x1 > b->w ? x1 - b->w : 0;
+    y1 = y1 > b->h ? y1 - b->h : 0;
+    /* grids are indexed with ints, halo, padding and all */
+    if ((b->w + x0 + x1 + 130) * (b->h + y0 + y1 + 2) > INT_MAX
+        || ((x0 | y0 | x1 | y1) != 0
+            && board_grow(b, (int)x0, (int)y0, (int)x1, (int)y1) != 0))
+      return 1;
+  }
+  hl_store_at(j->hl, BOARD_CUR(b), b->w, b->h, b->stride,
+              ox - b->ox, oy - b->oy);
+  return b->hashing ? board_hash_start(b) : 0;
+
+too_large:
+  errno = ENOMEM;
+  return -1;
+} /* macrocells */
+
+/*
+ * jump_run:
+ *  Advances b by n generations under the rule the kernels apply.
+ *  Returns 1 if the pattern came to more than a board can hold: b is
+ *  then as it was, and only j->population tells what it came to.  -1
+ *  if out of memory, or the universe outgrew Hashlife; b may then be
+ *  anywhere along the way.
+ *
+ */
+int
+jump_run(struct jump *j, struct board *b, unsigned long long n)
+{
+  const struct rule *r = grid_rule();
+
+  /* empty space comes alive under B0, and the plane is never done */
+  if (b->topology == BOARD_PLANE && (r->birth & 1)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (r->birth != j->rule.birth || r->survive != j->rule.survive) {
+    j->rule = *r;
+    j->w = 0;
+    if (j->hl != NULL)
+      hl_set_rule(j->hl, r);
+  }
+  if (b->topology != BOARD_PLANE || n < JUMP_HL_MIN)
+    return steps(j, b, n);
+  return macrocells(j, b, n);
+} /* jump_run */
+
+/*
+ * jump_how:
+ *  How the last jump was made
+ *
+ */
+const char *
+jump_how(const struct jump *j)
+{
+  return hows[j->how];
+} /* jump_how */
@@ -0,0 +1,55 @@
+#ifndef __JUMP_H
+#define __JUMP_H
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+#include "rule.h"
+
+/*
+ * Jumps a board many generations ahead at once, each jump the way
+ * that suits the board.  On a plane, Hashlife advances the universe by
+ * the powers of two that make up the jump, and the board grows to hold
+ * the result.  A bounded board is stepped, in blocks if it is dense
+ * and larger than the cache, by tiles if it is sparse, one generation
+ * at a time otherwise, until it repeats; what is left of the jump is
+ * then cut down to less than a period.
+ *
+ * What a jump works out is kept for the next in the same session: the
+ * macro-cells and their results, and whether the board it left repeats
+ * and how often, so going on from there is all but free.  A pattern on
+ * a plane can come to more than a board can hold, as anything that
+ * sends out gliders does given long enough; its population is still
+ * known.
+ *
+ */
+#define JUMP_STEPS    0         /* one generation at a time */
+#define JUMP_TILES    1
+#define JUMP_BLOCKS   2
+#define JUMP_HASHLIFE 3
+
+struct hashlife;
+struct block;
+struct cycle;
+
+struct jump {
+  size_t hlmem;                 /* Hashlife cache cap */
+  struct pool *pool;            /* threads to step on, or NULL */
+  struct hashlife *hl;          /* made on the first jump on a plane */
+  struct rule rule;             /* ... and the rule it was set to */
+  struct block *block;          /* scratch for blocked passes, if made */
+  int block_size;
+  struct cycle *cycle;          /* hashes of the generations stepped */
+  unsigned long long gen;       /* generations stepped, all jumps */
+  /* the board the last jump left, and its period if it repeats */
+  int w, h, topology;
+  uint64_t hash;
+  unsigned long long period;
+  int how;                      /* JUMP_* the last jump went by */
+  uint64_t population;          /* what the last jump came to */
+};
+
+struct jump *jump_new(size_t hlmem, struct pool *p);
+void jump_free(struct jump *j);
+int jump_run(struct jump *j, struct board *b, unsigned long long n);
+const char *jump_how(const struct jump *j);
+#endif
@@ -0,0 +1,268 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         packed.c
+* Description:  Bit-packed board, 64 cells per word
+*
+*******************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "packed.h"
+#include "rule.h"
+
+/*
+ * packed_new:
+ *  Allocates an all-dead w-by-h board; NULL if out of memory
+ *
+ */
+struct packed *
+packed_new(int w, int h)
+{
+  struct packed *p = malloc(sizeof(*p));
+
+  if (p == NULL)
+    return NULL;
+  p->w = w;
+  p->h = h;
+  p->words = (w + 63) / 64;
+  p->bits = calloc((size_t)p->words * h, sizeof(uint64_t));
+  p->scratch = calloc(3 * (size_t)p->words, sizeof(uint64_t));
+  if (p->bits == NULL || p->scratch == NULL) {
+    packed_free(p);
+    return NULL;
+  }
+  return p;
+} /* packed_new */
+
+/*
+ * packed_free:
+ *  Releases p and its rows
+ *
+ */
+void
+packed_free(struct packed *p)
+{
+  if (p == NULL)
+    return;
+  free(p->bits);
+  free(p->scratch);
+  free(p);
+} /* packed_free */
+
+/*
+ * packed_get:
+ *  Whether cell (x, y) of p is alive
+ *
+ */
+int
+packed_get(const struct packed *p, int x, int y)
+{
+  return (p->bits[(size_t)y * p->words + x / 64] >> (x % 64)) & 1;
+} /* packed_get */
+
+/*
+ * packed_set:
+ *  Brings cell (x, y) of p to life, or kills it
+ *
+ */
+void
+packed_set(struct packed *p, int x, int y, int alive)
+{
+  uint64_t *word = &p->bits[(size_t)y * p->words + x / 64];
+  uint64_t bit = (uint64_t)1 << (x % 64);
+
+  *word = alive ? *word | bit : *word & ~bit;
+} /* packed_set */
+
+/*
+ * packed_to_grid:
+ *  Copies the live cells of p into the w-by-h byte grid g with p's
+ *  top left corner at (x0, y0), dropping what falls outside
+ *
+ */
+void
+packed_to_grid(const struct packed *p, unsigned char *g, int w, int h,
+               int stride, int x0, int y0)
+{
+  int i, y;
+
+  for (y = 0; y < p->h; y++) {
+    const uint64_t *row = p->bits + (size_t)y * p->words;
+
+    if (y + y0 < 0 || y + y0 >= h)
+      continue;
+    for (i = 0; i < p->words; i++) {
+      uint64_t word = row[i];
+
+      while (word != 0) {
+        long x = (long)i * 64 + __builtin_ctzll(word) + x0;
+
+        if (x >= 0 && x < w)
+          g[(long)(y + y0) * stride + x] = 1;
+        word &= word - 1;
+      }
+    }
+  }
+} /* packed_to_grid */
+
+/*
+ * packed_from_grid:
+ *  Packs the first p->w by p->h cells of the byte grid g into p
+ *
+ */
+void
+packed_from_grid(struct packed *p, const unsigned char *g, int stride)
+{
+  int x, y;
+
+  memset(p->bits, 0, (size_t)p->words * p->h * sizeof(uint64_t));
+  for (y = 0; y < p->h; y++) {
+    uint64_t *row = p->bits + (size_t)y * p->words;
+
+    for (x = 0; x < p->w; x++)
+      row[x / 64] |= (uint64_t)(g[(long)y * stride + x] != 0) << (x % 64);
+  }
+} /* packed_from_grid */
+
+/*
+ * packed_row:
+ *  Computes one row of the next generation, 64 cells per iteration.
+ *  The eight neighbour words are the three source rows shifted by one
+ *  cell either way; they are summed with carry-save adders so that
+ *  each bit position holds its own neighbour count.
+ *
+ */
+static void
+packed_row(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+           uint64_t *out, int words, uint64_t last)
+{
+  int i;
+
+#define WEST(r)  ((r[i] << 1) | (i > 0 ? r[i - 1] >> 63 : 0))
+#define EAST(r)  ((r[i] >> 1) | (i + 1 < words ? r[i + 1] << 63 : 0))
+  for (i = 0; i < words; i++) {
+    uint64_t a, b, c, s_up, c_up, s_dn, c_dn, s_md, c_md;
+    uint64_t ones, k1, t_s, t_c, two;
+
+    /* up and down rows: three cells each, 0..3 as c:s */
+    a = WEST(up); b = up[i]; c = EAST(up);
+    s_up = a ^ b ^ c;
+    c_up = (a & b) | (c & (a ^ b));
+    a = WEST(down); b = down[i]; c = EAST(down);
+    s_dn = a ^ b ^ c;
+    c_dn = (a & b) | (c & (a ^ b));
+    /* middle row: the two horizontal neighbours, 0..2 */
+    a = WEST(mid); c = EAST(mid);
+    s_md = a ^ c;
+    c_md = a & c;
+
+    /* units of the total, and the carry into the twos */
+    ones = s_up ^ s_dn ^ s_md;
+    k1 = (s_up & s_dn) | (s_md & (s_up ^ s_dn));
+    /* exactly one of the four twos set means the total is 2 or 3 */
+    t_s = c_up ^ c_dn ^ c_md;
+    t_c = (c_up & c_dn) | (c_md & (c_up ^ c_dn));
+    two = ~t_c & (t_s ^ k1);
+
+    out[i] = two & (ones | mid[i]);
+  }
+  out[words - 1] &= last;
+#undef WEST
+#undef EAST
+} /* packed_row */
+
+/*
+ * rule_row:
+ *  Same as packed_row for any rule.  The neighbour count is carried to
+ *  all four of its bits, and each count the rule lists ors in the
+ *  cells that have exactly that many neighbours.
+ *
+ */
+static void
+rule_row(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+         uint64_t *out, int words, uint64_t last, const struct rule *r)
+{
+  int i, n;
+
+#define WEST(r)  ((r[i] << 1) | (i > 0 ? r[i - 1] >> 63 : 0))
+#define EAST(r)  ((r[i] >> 1) | (i + 1 < words ? r[i + 1] << 63 : 0))
+  for (i = 0; i < words; i++) {
+    uint64_t a, b, c, s_up, c_up, s_dn, c_dn, s_md, c_md, k1;
+    uint64_t x, y, bit[4], next = 0;
+
+    a = WEST(up); b = up[i]; c = EAST(up);
+    s_up = a ^ b ^ c;
+    c_up = (a & b) | (c & (a ^ b));
+    a = WEST(down); b = down[i]; c = EAST(down);
+    s_dn = a ^ b ^ c;
+    c_dn = (a & b) | (c & (a ^ b));
+    a = WEST(mid); c = EAST(mid);
+    s_md = a ^ c;
+    c_md = a & c;
+
+    bit[0] = s_up ^ s_dn ^ s_md;
+    k1 = (s_up & s_dn) | (s_md & (s_up ^ s_dn));
+    /* four twos, at most 4 of them set: sum them into bits 1 to 3 */
+    x = c_up ^ c_dn;
+    y = c_md ^ k1;
+    bit[1] = x ^ y;
+    a = c_up & c_dn;
+    b = c_md & k1;
+    c = x & y;
+    bit[2] = a ^ b ^ c;
+    bit[3] = (a & b) | (c & (a ^ b));
+
+    for (n = 0; n <= 8; n++) {
+      uint64_t eq = ((n & 1) ? bit[0] : ~bit[0]) & ((n & 2) ? bit[1] : ~bit[1])
+                  & ((n & 4) ? bit[2] : ~bit[2]) & ((n & 8) ? bit[3] : ~bit[3]);
+
+      if ((r->birth >> n) & 1)
+        next |= eq & ~mid[i];
+      if ((r->survive >> n) & 1)
+        next |= eq & mid[i];
+    }
+    out[i] = next;
+  }
+  out[words - 1] &= last;
+#undef WEST
+#undef EAST
+} /* rule_row */
+
+/*
+ * evolve_packed:
+ *  Advances p by one generation in place under rule r, or B3/S23 if r
+ *  is NULL.  Cells beyond the boundary are dead.  Only two rows of
+ *  scratch are needed: the original of the row above and of the row
+ *  being rewritten, plus a row of dead cells.
+ *
+ */
+void
+evolve_packed(struct packed *p, const struct rule *r)
+{
+  int y, words = p->words;
+  size_t bytes = (size_t)words * sizeof(uint64_t);
+  uint64_t *above = p->scratch, *here = above + words, *t;
+  const uint64_t *dead = here + words;
+  uint64_t last = p->w % 64 ? ((uint64_t)1 << (p->w % 64)) - 1 : ~(uint64_t)0;
+
+  if (p->w <= 0 || p->h <= 0)
+    return;
+  if (r != NULL && rule_is_life(r))
+    r = NULL;
+  memset(above, 0, bytes);
+  for (y = 0; y < p->h; y++) {
+    uint64_t *row = p->bits + (size_t)y * words;
+    const uint64_t *below = y + 1 < p->h ? row + words : dead;
+
+    memcpy(here, row, bytes);
+    if (r == NULL)
+      packed_row(above, here, below, row, words, last);
+    else
+      rule_row(above, here, below, row, words, last, r);
+    t = above;
+    above = here;
+    here = t;
+  }
+} /* evolve_packed */
@@ -0,0 +1,28 @@
+#ifndef __PACKED_H
+#define __PACKED_H
+#include <stdint.h>
+
+struct rule;
+
+/*
+ * A packed board stores one cell per bit, 64 cells per word.  Cell
+ * (x, y) is bit x % 64 of bits[y * words + x / 64]; bits past w in the
+ * last word of a row are always zero.
+ *
+ */
+struct packed {
+  int w, h;
+  int words;            /* words per row */
+  uint64_t *bits;
+  uint64_t *scratch;    /* three rows used by evolve_packed */
+};
+
+struct packed *packed_new(int w, int h);
+void packed_free(struct packed *p);
+int packed_get(const struct packed *p, int x, int y);
+void packed_set(struct packed *p, int x, int y, int alive);
+void packed_to_grid(const struct packed *p, unsigned char *g, int w, int h,
+                    int stride, int x0, int y0);
+void packed_from_grid(struct packed *p, const unsigned char *g, int stride);
+void evolve_packed(struct packed *p, const struct rule *r);
+#endif
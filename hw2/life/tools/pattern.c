@@ -0,0 +1,391 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         pattern.c
+* Description:  RLE and plaintext pattern files
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pattern.h"
+
+#define LINE_MAX_RLE 70         /* longest RLE body line we write */
+
+/*
+ * A cursor over the mapped file; nothing in it is NUL terminated
+ *
+ */
+struct text {
+  const char *p, *end;
+};
+
+static void
+skip_line(struct text *t)
+{
+  const char *nl = memchr(t->p, '\n', t->end - t->p);
+
+  t->p = nl != NULL ? nl + 1 : t->end;
+} /* skip_line */
+
+/*
+ * number:
+ *  Reads a decimal number at the cursor; -1 if there is none or it
+ *  does not fit an int
+ *
+ */
+static long
+number(struct text *t)
+{
+  long n = 0;
+
+  if (t->p == t->end || *t->p < '0' || *t->p > '9')
+    return -1;
+  while (t->p < t->end && *t->p >= '0' && *t->p <= '9') {
+    n = n * 10 + (*t->p++ - '0');
+    if (n > INT_MAX)
+      return -1;
+  }
+  return n;
+} /* number */
+
+/*
+ * set_run:
+ *  Sets n cells alive from (x, y), clipped to the row, a word at a
+ *  time where possible
+ *
+ */
+static void
+set_run(struct packed *p, long x, int y, long n)
+{
+  uint64_t *row = p->bits + (size_t)y * p->words;
+
+  if (x + n > p->w)
+    n = p->w - x;
+  while (n > 0 && x % 64 != 0) {
+    row[x / 64] |= (uint64_t)1 << (x % 64);
+    x++;
+    n--;
+  }
+  for (; n >= 64; n -= 64, x += 64)
+    row[x / 64] = ~(uint64_t)0;
+  if (n > 0)
+    row[x / 64] |= ((uint64_t)1 << n) - 1;
+} /* set_run */
+
+/*
+ * rle_header:
+ *  Reads "x = w, y = h[, rule = ...]" at the cursor
+ *
+ */
+static int
+rle_header(struct text *t, long *w, long *h)
+{
+  const char *keys = "xy";
+  long *vals[2] = { w, h };
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    while (t->p < t->end && (*t->p == ' ' || *t->p == '\t' || *t->p == ','))
+      t->p++;
+    if (t->p == t->end || *t->p++ != keys[i])
+      return -1;
+    while (t->p < t->end && *t->p == ' ')
+      t->p++;
+    if (t->p == t->end || *t->p++ != '=')
+      return -1;
+    while (t->p < t->end && *t->p == ' ')
+      t->p++;
+    if ((*vals[i] = number(t)) < 0)
+      return -1;
+  }
+  skip_line(t);
+  return 0;
+} /* rle_header */
+
+static struct packed *
+rle_load(struct text *t)
+{
+  long w, h, n, x = 0, y = 0;
+  struct packed *p;
+  char c;
+
+  while (t->p < t->end && *t->p == '#')
+    skip_line(t);
+  if (rle_header(t, &w, &h) != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((p = packed_new(w, h)) == NULL)
+    return NULL;
+  while (t->p < t->end) {
+    c = *t->p;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      t->p++;
+      continue;
+    }
+    n = 1;
+    if (c >= '0' && c <= '9') {
+      if ((n = number(t)) < 0 || t->p == t->end)
+        goto bad;
+      c = *t->p;
+    }
+    t->p++;
+    if (c == '!')
+      break;
+    if (c == '$') {
+      y += n;
+      x = 0;
+    } else if (c == 'b' || c == '.') {
+      x += n;
+    } else if (c == 'o' || (c >= 'A' && c <= 'X')) {
+      if (y < h && x < w)
+        set_run(p, x, y, n);
+      x += n;
+    } else {
+      goto bad;
+    }
+    if (x > INT_MAX || y > INT_MAX)
+      goto bad;
+  }
+  /* a missing '!' at the end of the file is forgiven */
+  return p;
+
+bad:
+  packed_free(p);
+  errno = EINVAL;
+  return NULL;
+} /* rle_load */
+
+/*
+ * cells_load:
+ *  Plaintext has no header, so the size takes a first pass, which
+ *  also turns down any cell that is not '.', 'O' or '*'
+ *
+ */
+static struct packed *
+cells_load(struct text *t)
+{
+  struct text scan = *t;
+  long w = 0, h = 0, x, i;
+  int y = 0;
+  struct packed *p;
+
+  while (scan.p < scan.end) {
+    const char *line = scan.p;
+
+    skip_line(&scan);
+    if (*line == '!')
+      continue;
+    x = scan.p - line;
+    while (x > 0 && (line[x - 1] == '\n' || line[x - 1] == '\r'))
+      x--;
+    for (i = 0; i < x; i++)
+      if (line[i] != '.' && line[i] != 'O' && line[i] != '*') {
+        errno = EINVAL;
+        return NULL;
+      }
+    if (x > w)
+      w = x;
+    if (++h > INT_MAX || w > INT_MAX) {
+      errno = EINVAL;
+      return NULL;
+    }
+  }
+  if ((p = packed_new(w, h)) == NULL)
+    return NULL;
+  while (t->p < t->end) {
+    if (*t->p == '!') {
+      skip_line(t);
+      continue;
+    }
+    for (x = 0; t->p < t->end && *t->p != '\n'; t->p++, x++)
+      if (*t->p == 'O' || *t->p == '*')
+        packed_set(p, x, y, 1);
+    if (t->p < t->end)
+      t->p++;
+    y++;
+  }
+  return p;
+} /* cells_load */
+
+/*
+ * pattern_load:
+ *  Maps path and decodes it; the format is told by its first line
+ *  that is not a comment
+ *
+ */
+struct packed *
+pattern_load(const char *path)
+{
+  int fd, saved;
+  struct stat st;
+  void *map;
+  struct text t;
+  struct packed *p;
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0) {
+    saved = errno;
+    close(fd);
+    errno = saved;
+    return NULL;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  saved = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    errno = saved;
+    return NULL;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  t.p = map;
+  t.end = t.p + st.st_size;
+  while (t.p < t.end && (*t.p == '#' || *t.p == '!'))
+    skip_line(&t);
+  if (t.p < t.end && *t.p == 'x') {
+    t.p = map;
+    p = rle_load(&t);
+  } else {
+    t.p = map;
+    p = cells_load(&t);
+  }
+  saved = errno;
+  munmap(map, st.st_size);
+  errno = saved;
+  return p;
+} /* pattern_load */
+
+/*
+ * run:
+ *  Length of the run of cells equal to cell x of row, up to w
+ *
+ */
+static long
+run(const uint64_t *row, long x, long w)
+{
+  uint64_t flip = (row[x / 64] >> (x % 64)) & 1 ? ~(uint64_t)0 : 0;
+  uint64_t diff = (row[x / 64] ^ flip) >> (x % 64);
+  long start = x;
+
+  if (diff != 0)
+    x += __builtin_ctzll(diff);
+  else
+    for (x = (x / 64 + 1) * 64; x < w; x += 64) {
+      diff = row[x / 64] ^ flip;
+      if (diff != 0) {
+        x += __builtin_ctzll(diff);
+        break;
+      }
+    }
+  return (x < w ? x : w) - start;
+} /* run */
+
+/*
+ * rle_token:
+ *  Writes one run, wrapping lines at LINE_MAX_RLE
+ *
+ */
+static void
+rle_token(FILE *f, long n, char tag, int *col)
+{
+  char buf[24];
+  int len = n > 1 ? snprintf(buf, sizeof(buf), "%ld%c", n, tag)
+                  : snprintf(buf, sizeof(buf), "%c", tag);
+
+  if (*col + len > LINE_MAX_RLE) {
+    fputc('\n', f);
+    *col = 0;
+  }
+  fputs(buf, f);
+  *col += len;
+} /* rle_token */
+
+static void
+rle_save(const struct packed *p, const char *rule, FILE *f)
+{
+  long x, n, ends = 0;
+  int y, col = 0;
+
+  fprintf(f, "x = %d, y = %d, rule = %s\n", p->w, p->h, rule);
+  for (y = 0; y < p->h; y++) {
+    const uint64_t *row = p->bits + (size_t)y * p->words;
+
+    for (x = 0; x < p->w; x += n) {
+      n = run(row, x, p->w);
+      if (x + n == p->w && !((row[x / 64] >> (x % 64)) & 1))
+        break;                  /* trailing dead cells are implied */
+      if (ends > 0) {
+        rle_token(f, ends, '$', &col);
+        ends = 0;
+      }
+      rle_token(f, n, (row[x / 64] >> (x % 64)) & 1 ? 'o' : 'b', &col);
+    }
+    ends++;
+  }
+  rle_token(f, 1, '!', &col);
+  fputc('\n', f);
+} /* rle_save */
+
+/*
+ * cells_save:
+ *  Writes p as plaintext, named after the file it goes to, less its
+ *  directory and extension
+ *
+ */
+static void
+cells_save(const struct packed *p, const char *path, FILE *f)
+{
+  const char *name = strrchr(path, '/');
+  int x, y, last;
+
+  name = name != NULL ? name + 1 : path;
+  fprintf(f, "!Name: %.*s\n", (int)(strlen(name) - 6), name);
+  for (y = 0; y < p->h; y++) {
+    for (last = p->w - 1; last >= 0 && !packed_get(p, last, y); last--)
+      ;
+    for (x = 0; x <= last; x++)
+      fputc(packed_get(p, x, y) ? 'O' : '.', f);
+    fputc('\n', f);
+  }
+} /* cells_save */
+
+/*
+ * pattern_save:
+ *  Streams p to path, as plaintext if the name ends in ".cells" and
+ *  as RLE otherwise.  The RLE header names rule, B3/S23 if NULL.
+ *
+ */
+int
+pattern_save(const struct packed *p, const char *rule, const char *path)
+{
+  size_t len = strlen(path);
+  FILE *f = fopen(path, "w");
+
+  if (f == NULL)
+    return -1;
+  if (len > 6 && strcmp(path + len - 6, ".cells") == 0)
+    cells_save(p, path, f);
+  else
+    rle_save(p, rule != NULL ? rule : "B3/S23", f);
+  if (ferror(f)) {
+    fclose(f);
+    errno = EIO;
+    return -1;
+  }
+  return fclose(f);
+} /* pattern_save */
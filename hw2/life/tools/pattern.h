@@ -0,0 +1,15 @@
+#ifndef __PATTERN_H
+#define __PATTERN_H
+#include "packed.h"
+
+/*
+ * Pattern files in the two common formats: RLE (".rle", a header line
+ * "x = w, y = h" and run-length encoded rows) and plaintext (".cells",
+ * 'O' alive and '.' dead, '!' comment lines).  Files are read through
+ * mmap and decoded straight into a packed board.  On failure NULL or -1
+ * is returned with errno set; EINVAL means the file is malformed.
+ *
+ */
+struct packed *pattern_load(const char *path);
+int pattern_save(const struct packed *p, const char *rule, const char *path);
+#endif
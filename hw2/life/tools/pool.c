@@ -0,0 +1,183 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         pool.c
+* Description:  Worker pool evolving a grid in row bands
+*
+*******************************************************************************
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "grid.h"
+#include "pool.h"
+
+struct worker {
+  struct pool *pool;
+  int id;
+  pthread_t tid;
+};
+
+struct pool {
+  int n;
+  int quit;
+  pthread_mutex_t lock;         /* held while the workers are created */
+  pthread_barrier_t start, done;
+  struct worker *workers;
+  /* the job being run, set before start is released */
+  pool_job_t job;
+  void *arg;
+  int rows;
+  /* the generation being computed by pool_evolve */
+  const unsigned char *src;
+  unsigned char *dst;
+  int w, stride;
+};
+
+/*
+ * band:
+ *  Runs the job on the rows that belong to worker id
+ *
+ */
+static void
+band(struct pool *p, int id)
+{
+  int y0 = (int)((long)p->rows * id / p->n);
+  int y1 = (int)((long)p->rows * (id + 1) / p->n);
+
+  if (y0 < y1)
+    p->job(p->arg, y0, y1);
+} /* band */
+
+static void *
+worker_main(void *arg)
+{
+  struct worker *me = arg;
+  struct pool *p = me->pool;
+
+  pthread_mutex_lock(&p->lock);
+  pthread_mutex_unlock(&p->lock);
+  for (;;) {
+    pthread_barrier_wait(&p->start);
+    if (p->quit)
+      break;
+    band(p, me->id);
+    pthread_barrier_wait(&p->done);
+  }
+  return NULL;
+} /* worker_main */
+
+/*
+ * pool_new:
+ *  Starts nthreads - 1 workers.  If the system refuses some of them
+ *  the pool runs with those it got.  NULL if out of memory.
+ *
+ */
+struct pool *
+pool_new(int nthreads)
+{
+  int i;
+  struct pool *p;
+
+  if (nthreads < 1)
+    nthreads = 1;
+  p = calloc(1, sizeof(*p));
+  if (p == NULL)
+    return NULL;
+  p->workers = calloc(nthreads, sizeof(*p->workers));
+  if (p->workers == NULL) {
+    free(p);
+    return NULL;
+  }
+  /* the barriers are sized once we know how many workers started */
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_mutex_lock(&p->lock);
+  for (i = 1; i < nthreads; i++) {
+    p->workers[i].pool = p;
+    p->workers[i].id = i;
+    if (pthread_create(&p->workers[i].tid, NULL, worker_main,
+                       &p->workers[i]) != 0)
+      break;
+  }
+  p->n = i;
+  pthread_barrier_init(&p->start, NULL, p->n);
+  pthread_barrier_init(&p->done, NULL, p->n);
+  pthread_mutex_unlock(&p->lock);
+  return p;
+} /* pool_new */
+
+int
+pool_threads(const struct pool *p)
+{
+  return p->n;
+} /* pool_threads */
+
+/*
+ * pool_run:
+ *  Calls job(arg, y0, y1) on every thread, splitting [0, rows) into
+ *  one band per thread.  Returns once every band is done.
+ *
+ */
+void
+pool_run(struct pool *p, pool_job_t job, void *arg, int rows)
+{
+  p->job = job;
+  p->arg = arg;
+  p->rows = rows;
+  if (p->n == 1) {
+    band(p, 0);
+    return;
+  }
+  pthread_barrier_wait(&p->start);
+  band(p, 0);
+  pthread_barrier_wait(&p->done);
+} /* pool_run */
+
+static void
+evolve_job(void *arg, int y0, int y1)
+{
+  struct pool *p = arg;
+
+  evolve_grid_rows(p->src, p->dst, p->w, p->stride, y0, y1);
+} /* evolve_job */
+
+/*
+ * pool_evolve:
+ *  Writes the generation after src into dst, one band per thread
+ *
+ */
+void
+pool_evolve(struct pool *p, const unsigned char *src, unsigned char *dst,
+            int w, int h, int stride)
+{
+  p->src = src;
+  p->dst = dst;
+  p->w = w;
+  p->stride = stride;
+  pool_run(p, evolve_job, p, h);
+} /* pool_evolve */
+
+/*
+ * pool_free:
+ *  Stops the workers and releases p
+ *
+ */
+void
+pool_free(struct pool *p)
+{
+  int i;
+
+  if (p == NULL)
+    return;
+  if (p->n > 1) {
+    p->quit = 1;
+    pthread_barrier_wait(&p->start);
+    for (i = 1; i < p->n; i++)
+      pthread_join(p->workers[i].tid, NULL);
+  }
+  pthread_barrier_destroy(&p->start);
+  pthread_barrier_destroy(&p->done);
+  pthread_mutex_destroy(&p->lock);
+  free(p->workers);
+  free(p);
+} /* pool_free */
@@ -0,0 +1,20 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+/*
+ * A pool of worker threads that evolve a grid, or run any other job,
+ * in horizontal bands.  The calling thread works on the first band, so
+ * a pool of one thread starts no workers at all.
+ *
+ */
+struct pool;
+
+typedef void (*pool_job_t)(void *arg, int y0, int y1);
+
+struct pool *pool_new(int nthreads);
+int pool_threads(const struct pool *p);
+void pool_run(struct pool *p, pool_job_t job, void *arg, int rows);
+void pool_evolve(struct pool *p, const unsigned char *src, unsigned char *dst,
+                 int w, int h, int stride);
+void pool_free(struct pool *p);
+#endif
@@ -0,0 +1,158 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         render.c
+* Description:  Batched, diff-based terminal renderer
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "render.h"
+
+/*
+ * ASCII escape sequences used:
+ *  Move cursor to row r, column c   \033[r;cH
+ *  Clear the screen                 \033[2J
+ *  Blue                             \033[44m
+ *  Turn off attributes              \033[m
+ *  Clear to the end of the line     \033[K
+ *
+ */
+#define UNKNOWN 2
+#define MOVE_MAX 24             /* \033[r;cH with two 10-digit numbers */
+#define CELL_MAX 7              /* an attribute change and two spaces */
+#define GAP 3                   /* unchanged cells redrawn to save a move */
+#define STATUS_MAX 256
+
+/*
+ * render_new:
+ *  A renderer writing to fd; NULL if out of memory
+ *
+ */
+struct render *
+render_new(int w, int h, int fd)
+{
+  struct render *r = calloc(1, sizeof(*r));
+
+  if (r == NULL)
+    return NULL;
+  r->w = w;
+  r->h = h;
+  r->fd = fd;
+  r->cap = (size_t)w * h * (MOVE_MAX + CELL_MAX) + 2 * MOVE_MAX + STATUS_MAX;
+  r->screen = malloc((size_t)w * h);
+  r->buf = malloc(r->cap);
+  if (r->screen == NULL || r->buf == NULL) {
+    render_free(r);
+    return NULL;
+  }
+  memset(r->screen, UNKNOWN, (size_t)w * h);
+  return r;
+} /* render_new */
+
+void
+render_free(struct render *r)
+{
+  if (r == NULL)
+    return;
+  free(r->screen);
+  free(r->buf);
+  free(r);
+} /* render_free */
+
+static void
+put(struct render *r, const char *s, size_t n)
+{
+  memcpy(r->buf + r->len, s, n);
+  r->len += n;
+} /* put */
+
+static void
+put_num(struct render *r, unsigned n)
+{
+  char digits[10];
+  int i = 0;
+
+  do {
+    digits[i++] = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+  while (i > 0)
+    r->buf[r->len++] = digits[--i];
+} /* put_num */
+
+static void
+move(struct render *r, int row, int col)
+{
+  put(r, "\033[", 2);
+  put_num(r, row);
+  put(r, ";", 1);
+  put_num(r, col);
+  put(r, "H", 1);
+} /* move */
+
+/*
+ * render_frame:
+ *  Draws g, leaving status (if not NULL) on the line below it.  Returns
+ *  -1 if the terminal could not be written to.
+ *
+ */
+int
+render_frame(struct render *r, const unsigned char *g, int stride,
+             const char *status)
+{
+  int x, y, end, attr = 0;
+  ssize_t n;
+  size_t off;
+
+  r->len = 0;
+  if (r->screen[0] == UNKNOWN)
+    put(r, "\033[H\033[2J", 7);
+  for (y = 0; y < r->h; y++) {
+    const unsigned char *row = g + y * stride;
+    unsigned char *seen = r->screen + y * r->w;
+
+    for (x = 0; x < r->w; x++) {
+      if (row[x] == seen[x])
+        continue;
+      /* a run of changes, bridging short gaps of unchanged cells */
+      for (end = x + 1; end < r->w; end++) {
+        int next = end;
+
+        while (next < r->w && next - end < GAP && row[next] == seen[next])
+          next++;
+        if (next == r->w || row[next] == seen[next])
+          break;
+        end = next;
+      }
+      move(r, y + 1, 2 * x + 1);
+      for (; x < end; x++) {
+        if (row[x] != attr) {
+          attr = row[x];
+          put(r, attr ? "\033[44m" : "\033[m", attr ? 5 : 3);
+        }
+        put(r, "  ", 2);
+        seen[x] = row[x];
+      }
+    }
+  }
+  if (attr)
+    put(r, "\033[m", 3);
+  move(r, r->h + 1, 1);
+  if (status != NULL)
+    put(r, status, strnlen(status, STATUS_MAX - 3));
+  put(r, "\033[K", 3);
+
+  for (off = 0; off < r->len; off += n) {
+    n = write(r->fd, r->buf + off, r->len - off);
+    if (n < 0 && errno == EINTR)
+      n = 0;
+    else if (n < 0)
+      return -1;
+  }
+  return 0;
+} /* render_frame */
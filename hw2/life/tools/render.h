@@ -0,0 +1,24 @@
+#ifndef __RENDER_H
+#define __RENDER_H
+#include <stddef.h>
+
+/*
+ * A renderer draws successive frames of a w-by-h grid on the terminal.
+ * It remembers what is on screen and only sends the cells that changed,
+ * building the whole frame in one buffer sized for the worst case and
+ * writing it out with a single write(2).
+ *
+ */
+struct render {
+  int w, h;
+  int fd;
+  unsigned char *screen;        /* cell states on screen, 2 if unknown */
+  char *buf;
+  size_t len, cap;
+};
+
+struct render *render_new(int w, int h, int fd);
+void render_free(struct render *r);
+int render_frame(struct render *r, const unsigned char *g, int stride,
+                 const char *status);
+#endif
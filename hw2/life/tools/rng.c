@@ -0,0 +1,47 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         rng.c
+* Description:  Seeded random soup
+*
+*******************************************************************************
+*/
+
+#include "rng.h"
+
+/*
+ * rng_seed:
+ *  Starts stream number stream of seed.  The two are mixed through
+ *  splitmix64 so that neighbouring streams are unrelated and the
+ *  state is never zero.
+ *
+ */
+void
+rng_seed(struct rng *r, uint64_t seed, uint64_t stream)
+{
+  uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ull;
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  r->s = z != 0 ? z : 1;
+} /* rng_seed */
+
+/*
+ * rng_fill:
+ *  Sets each of n cells alive with probability density, four cells
+ *  per 64-bit draw
+ *
+ */
+void
+rng_fill(struct rng *r, unsigned char *cells, int n, double density)
+{
+  int i, k;
+  uint64_t bits, limit = (uint64_t)(density * 65536);
+
+  for (i = 0; i < n; i += 4) {
+    bits = rng_next(r);
+    for (k = 0; k < 4 && i + k < n; k++, bits >>= 16)
+      cells[i + k] = (bits & 0xffff) < limit;
+  }
+} /* rng_fill */
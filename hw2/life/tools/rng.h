@@ -0,0 +1,26 @@
+#ifndef __RNG_H
+#define __RNG_H
+#include <stdint.h>
+
+/*
+ * xorshift64* generator.  Streams started from the same seed and
+ * stream number are identical on every host, whatever thread runs them.
+ *
+ */
+struct rng {
+  uint64_t s;
+};
+
+void rng_seed(struct rng *r, uint64_t seed, uint64_t stream);
+
+static inline uint64_t
+rng_next(struct rng *r)
+{
+  r->s ^= r->s >> 12;
+  r->s ^= r->s << 25;
+  r->s ^= r->s >> 27;
+  return r->s * 0x2545f4914f6cdd1dull;
+} /* rng_next */
+
+void rng_fill(struct rng *r, unsigned char *cells, int n, double density);
+#endif
@@ -0,0 +1,119 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         rule.c
+* Description:  Outer-totalistic rules in B/S notation
+*
+*******************************************************************************
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include "rule.h"
+
+#define LIFE_BIRTH   (1 << 3)
+#define LIFE_SURVIVE ((1 << 2) | (1 << 3))
+
+/*
+ * compile:
+ *  Fills in the table and the canonical name from birth and survive
+ *
+ */
+static void
+compile(struct rule *r)
+{
+  int i, n, len;
+
+  for (i = 0; i < 512; i++) {
+    n = __builtin_popcount(i & ~0x10);
+    r->table[i] = (((i & 0x10) ? r->survive : r->birth) >> n) & 1;
+  }
+  len = snprintf(r->name, sizeof(r->name), "B");
+  for (n = 0; n <= 8; n++)
+    if (r->birth & (1 << n))
+      r->name[len++] = '0' + n;
+  r->name[len++] = '/';
+  r->name[len++] = 'S';
+  for (n = 0; n <= 8; n++)
+    if (r->survive & (1 << n))
+      r->name[len++] = '0' + n;
+  r->name[len] = '\0';
+} /* compile */
+
+/*
+ * digits:
+ *  Reads neighbour counts 0-8 into a mask; -1 on anything else
+ *
+ */
+static int
+digits(const char **s)
+{
+  int mask = 0;
+
+  while (**s >= '0' && **s <= '8')
+    mask |= 1 << (*(*s)++ - '0');
+  return **s == '\0' || **s == '/' ? mask : -1;
+} /* digits */
+
+/*
+ * rule_parse:
+ *  Compiles a rule written "B36/S23" (either order, any case) or in
+ *  the older "23/36" survive/birth form; -1 if s is not a rule
+ *
+ */
+int
+rule_parse(struct rule *r, const char *s)
+{
+  int part, mask, b = -1, sv = -1;
+
+  if (isdigit((unsigned char)*s) || *s == '/') {
+    /* survive/birth */
+    if ((sv = digits(&s)) < 0 || *s++ != '/' || (b = digits(&s)) < 0
+        || *s != '\0')
+      return -1;
+  } else {
+    for (part = 0; part < 2; part++) {
+      char c = tolower((unsigned char)*s++);
+
+      if ((c != 'b' && c != 's') || (mask = digits(&s)) < 0)
+        return -1;
+      if (c == 'b')
+        b = mask;
+      else
+        sv = mask;
+      if (*s == '\0')
+        break;
+      s++;
+    }
+    if (b < 0 || sv < 0 || *s != '\0')
+      return -1;
+  }
+  r->birth = b;
+  r->survive = sv;
+  compile(r);
+  return 0;
+} /* rule_parse */
+
+/*
+ * rule_life:
+ *  Conway's rule, B3/S23
+ *
+ */
+void
+rule_life(struct rule *r)
+{
+  r->birth = LIFE_BIRTH;
+  r->survive = LIFE_SURVIVE;
+  compile(r);
+} /* rule_life */
+
+/*
+ * rule_is_life:
+ *  Whether r is B3/S23, for engines with a faster path for it
+ *
+ */
+int
+rule_is_life(const struct rule *r)
+{
+  return r->birth == LIFE_BIRTH && r->survive == LIFE_SURVIVE;
+} /* rule_is_life */
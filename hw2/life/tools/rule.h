@@ -0,0 +1,25 @@
+#ifndef __RULE_H
+#define __RULE_H
+#include <stdint.h>
+
+/*
+ * An outer-totalistic rule: whether a cell is alive next generation
+ * depends only on its own state and on how many of its eight
+ * neighbours are alive.  It is compiled to a table indexed by the 3x3
+ * neighbourhood, three bits per column from left to right, each column
+ * holding the cells above (bit 0), at (bit 1) and below (bit 2).  The
+ * cell itself is bit 4.
+ *
+ */
+struct rule {
+  char name[24];                /* canonical "B3/S23" form */
+  uint16_t birth, survive;      /* bit n set: n neighbours give a live cell */
+  unsigned char table[512];
+};
+
+#define RULE_INDEX(left, mid, right) (((left) << 6) | ((mid) << 3) | (right))
+
+int rule_parse(struct rule *r, const char *s);
+void rule_life(struct rule *r);
+int rule_is_life(const struct rule *r);
+#endif
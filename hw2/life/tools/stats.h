@@ -0,0 +1,31 @@
+#ifndef __STATS_H
+#define __STATS_H
+#include <stdint.h>
+#include "board.h"
+
+/*
+ * A log of what each generation of a game did, one record a frame.
+ * Births and deaths are counted since the frame before, which is one
+ * generation back unless the engine takes larger steps.  Written as
+ * CSV if the file name ends in .csv, and otherwise as binary: the
+ * eight bytes "LIFESTAT", then records of six 64-bit integers in the
+ * order of struct stats_rec, in the byte order of the host.
+ *
+ */
+struct stats_rec {
+  uint64_t gen;
+  uint64_t population;
+  uint64_t births, deaths;
+  uint64_t evolve_ns;           /* spent reaching this generation */
+  uint64_t render_ns;           /* spent handing it to the display */
+};
+
+struct stats;
+
+struct stats *stats_open(const char *path);
+int stats_close(struct stats *s);
+uint64_t stats_clock(void);
+void stats_count(struct stats_rec *r, const struct board *b, struct pool *p,
+                 uint64_t population);
+int stats_write(struct stats *s, const struct stats_rec *r);
+#endif
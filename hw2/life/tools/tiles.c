@@ -0,0 +1,169 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         tiles.c
+* Description:  Tiled evolution skipping stable and empty regions
+*
+*******************************************************************************
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "tiles.h"
+
+/*
+ * layout:
+ *  Lays tiles over a w-by-h board, all of them due for the next
+ *  generation; -1 if out of memory
+ *
+ */
+static int
+layout(struct tiles *t, int w, int h)
+{
+  size_t n = (size_t)((w + t->size - 1) / t->size) * ((h + t->size - 1) / t->size);
+  unsigned char *changed = realloc(t->changed, n);
+  unsigned char *active = changed ? realloc(t->active, n) : NULL;
+
+  if (changed != NULL)
+    t->changed = changed;
+  if (active == NULL)
+    return -1;
+  t->active = active;
+  t->w = w;
+  t->h = h;
+  t->nx = (w + t->size - 1) / t->size;
+  t->ny = (h + t->size - 1) / t->size;
+  memset(t->changed, 1, n);
+  return 0;
+} /* layout */
+
+/*
+ * tiles_new:
+ *  Tiles b in size-by-size tiles; NULL if out of memory
+ *
+ */
+struct tiles *
+tiles_new(const struct board *b, int size)
+{
+  struct tiles *t = calloc(1, sizeof(*t));
+
+  if (t == NULL)
+    return NULL;
+  t->size = size;
+  if (layout(t, b->w, b->h) != 0) {
+    tiles_free(t);
+    return NULL;
+  }
+  return t;
+} /* tiles_new */
+
+void
+tiles_free(struct tiles *t)
+{
+  if (t == NULL)
+    return;
+  free(t->changed);
+  free(t->active);
+  free(t);
+} /* tiles_free */
+
+/*
+ * activate:
+ *  Marks every tile next to a changed one as active; on a torus the
+ *  tiles on opposite edges are neighbours
+ *
+ */
+static void
+activate(struct tiles *t, int torus)
+{
+  int i, j, di, dj, ti, tj;
+
+  memset(t->active, 0, (size_t)t->nx * t->ny);
+  for (j = 0; j < t->ny; j++)
+    for (i = 0; i < t->nx; i++) {
+      if (!t->changed[j * t->nx + i])
+        continue;
+      for (dj = -1; dj <= 1; dj++)
+        for (di = -1; di <= 1; di++) {
+          ti = i + di;
+          tj = j + dj;
+          if (torus) {
+            ti = (ti + t->nx) % t->nx;
+            tj = (tj + t->ny) % t->ny;
+          }
+          if (ti >= 0 && ti < t->nx && tj >= 0 && tj < t->ny)
+            t->active[tj * t->nx + ti] = 1;
+        }
+    }
+} /* activate */
+
+/*
+ * rehash:
+ *  Brings the hash of b up to date with the tiles that changed.  It
+ *  waits for every tile to be done: a word of the hash can straddle
+ *  two tiles.
+ *
+ */
+static void
+rehash(struct tiles *t, struct board *b)
+{
+  int i, j, x0, y0;
+
+  for (j = 0; j < t->ny; j++)
+    for (i = 0; i < t->nx; i++) {
+      if (!t->changed[j * t->nx + i])
+        continue;
+      x0 = i * t->size;
+      y0 = j * t->size;
+      b->hash.sum += grid_hash_rows(&b->hash, BOARD_NEXT(b), b->w, b->stride,
+                                    x0, b->w - x0 < t->size ? b->w : x0 + t->size,
+                                    y0, b->h - y0 < t->size ? b->h : y0 + t->size);
+    }
+} /* rehash */
+
+/*
+ * tiles_step:
+ *  Advances b by one generation and returns how many tiles had to be
+ *  recomputed; -1 if the board or the tiles could not grow
+ *
+ */
+long
+tiles_step(struct tiles *t, struct board *b)
+{
+  int i, j, x0, y0, cols, rows, y;
+  long n = 0;
+  const unsigned char *src;
+  unsigned char *dst;
+
+  if (board_prepare(b) != 0)
+    return -1;
+  /* a plane that grew has new grids, so every tile is recomputed */
+  if ((b->w != t->w || b->h != t->h) && layout(t, b->w, b->h) != 0)
+    return -1;
+  src = BOARD_CUR(b);
+  dst = BOARD_NEXT(b);
+  activate(t, b->topology == BOARD_TORUS);
+  for (j = 0; j < t->ny; j++) {
+    y0 = j * t->size;
+    rows = b->h - y0 < t->size ? b->h - y0 : t->size;
+    for (i = 0; i < t->nx; i++) {
+      unsigned char *changed = &t->changed[j * t->nx + i];
+
+      *changed = 0;
+      if (!t->active[j * t->nx + i])
+        continue;
+      n++;
+      x0 = i * t->size;
+      cols = b->w - x0 < t->size ? b->w - x0 : t->size;
+      evolve_grid_rows(src + x0, dst + x0, cols, b->stride, y0, y0 + rows);
+      for (y = y0; y < y0 + rows && !*changed; y++)
+        *changed = memcmp(src + y * b->stride + x0,
+                          dst + y * b->stride + x0, cols) != 0;
+    }
+  }
+  if (b->hashing)
+    rehash(t, b);
+  board_swap(b);
+  return n;
+} /* tiles_step */
@@ -0,0 +1,22 @@
+#ifndef __TILES_H
+#define __TILES_H
+#include "board.h"
+
+/*
+ * Tiled evolution of a board.  A tile is recomputed only if it or one
+ * of its eight neighbours changed in the last generation; any other
+ * tile is the same in both grids of the board and is left alone.
+ *
+ */
+struct tiles {
+  int size;                     /* tiles are size-by-size cells */
+  int w, h;                     /* size of the board they were laid on */
+  int nx, ny;                   /* tiles across and down */
+  unsigned char *changed;       /* per tile, changed in the last generation */
+  unsigned char *active;        /* per tile, to be recomputed */
+};
+
+struct tiles *tiles_new(const struct board *b, int size);
+void tiles_free(struct tiles *t);
+long tiles_step(struct tiles *t, struct board *b);
+#endif
@@ -1,6 +0,0 @@
-#ifndef __TOOLS_H
-#define __TOOLS_H
-void show(void *u, int w, int h);
-void evolve(void *u, int w, int h);
-#endif
-
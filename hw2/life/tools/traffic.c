@@ -0,0 +1,74 @@
+/* -*-C-*-
+*******************************************************************************
+*
+* File:         traffic.c
+* Description:  Memory traffic from the last-level cache miss counter
+*
+*******************************************************************************
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include "traffic.h"
+
+#define LINE 64                 /* bytes brought in by a miss */
+
+/*
+ * traffic_open:
+ *  Starts counting the last-level cache misses of this process, and of
+ *  the threads and processes it starts from now on.  Returns the
+ *  counter, or -1 with errno set if the CPU or the kernel will not
+ *  count them for us.
+ *
+ */
+int
+traffic_open(void)
+{
+  struct perf_event_attr a;
+
+  memset(&a, 0, sizeof(a));
+  a.size = sizeof(a);
+  a.type = PERF_TYPE_HARDWARE;
+  a.config = PERF_COUNT_HW_CACHE_MISSES;
+  a.inherit = 1;
+  /* all an unprivileged process may count, and all that evolving does */
+  a.exclude_kernel = 1;
+  a.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+} /* traffic_open */
+
+/*
+ * traffic_read:
+ *  Sets bytes to the traffic counted by fd so far; -1 with errno set if
+ *  it cannot be read
+ *
+ */
+int
+traffic_read(int fd, uint64_t *bytes)
+{
+  uint64_t misses;
+
+  errno = 0;
+  if (read(fd, &misses, sizeof(misses)) != sizeof(misses)) {
+    if (errno == 0)
+      errno = EIO;
+    return -1;
+  }
+  *bytes = misses * LINE;
+  return 0;
+} /* traffic_read */
+
+/*
+ * traffic_close:
+ *  Stops counting
+ *
+ */
+void
+traffic_close(int fd)
+{
+  if (fd >= 0)
+    close(fd);
+} /* traffic_close */
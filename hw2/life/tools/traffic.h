@@ -0,0 +1,15 @@
+#ifndef __TRAFFIC_H
+#define __TRAFFIC_H
+#include <stdint.h>
+
+/*
+ * Memory traffic, as counted by the CPU: each last-level cache miss
+ * is taken to bring one 64-byte line in from memory.  What the
+ * hardware prefetchers bring in, and lines written back, are not
+ * misses, so this is a lower bound.
+ *
+ */
+int traffic_open(void);
+int traffic_read(int fd, uint64_t *bytes);
+void traffic_close(int fd);
+#endif
@@ -0,0 +1,140 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Times kma_malloc and kma_free alone, replaying a trace
+ *    File: bench.c
+ ***************************************************************************/
+
+/************System include***********************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/************Private include**********************************************/
+#include "kpage.h"
+#include "kma.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+typedef struct
+{
+  int alloc;	/* REQUEST if true, FREE otherwise */
+  int id;
+} op_t;
+
+/************Function Prototypes******************************************/
+void usage(char*);
+void error(char*, char*);
+
+/**************Implementation***********************************************/
+
+/*
+ * The trace is parsed into memory first, so that each pass times the
+ * allocator and nothing else: no file reads, no filling or checking of
+ * the buffers as kma.c does.  Every pass replays the whole trace, which
+ * frees all it requests, so the allocator starts each pass empty.  The
+ * best pass is reported, as the one least disturbed by the rest of the
+ * machine.
+ */
+int
+main(int argc, char* argv[])
+{
+  int n_req, n_ops = 0, reps, i, r, req_id, req_size;
+  char command[16];
+  FILE* f_test;
+  op_t* ops;
+  int* sizes;
+  void** ptrs;
+  double ns, best = -1;
+  struct timespec start, end;
+
+  if (argc != 3 || (reps = atoi(argv[2])) <= 0)
+    {
+      usage(argv[0]);
+    }
+
+  f_test = fopen(argv[1], "r");
+  if (f_test == NULL)
+    {
+      error("unable to open input test file", argv[1]);
+    }
+  if (fscanf(f_test, "%d\n", &n_req) != 1 || n_req <= 0)
+    error("Couldn't read number of requests at head of file", "");
+
+  /* the head of the trace counts its lines, and bounds the ids */
+  ops = malloc(n_req * sizeof(op_t));
+  sizes = calloc(n_req, sizeof(int));
+  ptrs = calloc(n_req, sizeof(void*));
+  if (ops == NULL || sizes == NULL || ptrs == NULL)
+    error("out of memory for trace", argv[1]);
+
+  while (n_ops < n_req && fscanf(f_test, "%10s", command) == 1)
+    {
+      if (strcmp(command, "REQUEST") == 0)
+	{
+	  if (fscanf(f_test, "%d %d", &req_id, &req_size) != 2)
+	    error("Not enough arguments to REQUEST", "");
+	  ops[n_ops].alloc = TRUE;
+	}
+      else if (strcmp(command, "FREE") == 0)
+	{
+	  if (fscanf(f_test, "%d", &req_id) != 1)
+	    error("Not enough arguments to FREE", "");
+	  ops[n_ops].alloc = FALSE;
+	}
+      else
+	{
+	  error("unknown command type:", command);
+	}
+      if (req_id < 0 || req_id >= n_req)
+	error("request id out of range in", argv[1]);
+      if (ops[n_ops].alloc)
+	sizes[req_id] = req_size;
+      ops[n_ops++].id = req_id;
+    }
+  fclose(f_test);
+
+  for (r = 0; r < reps; r++)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (i = 0; i < n_ops; i++)
+	{
+	  req_id = ops[i].id;
+	  if (ops[i].alloc)
+	    ptrs[req_id] = kma_malloc(sizes[req_id]);
+	  else
+	    kma_free(ptrs[req_id], sizes[req_id]);
+	}
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      ns = ((end.tv_sec - start.tv_sec) * 1e9
+	    + (end.tv_nsec - start.tv_nsec)) / n_ops;
+      if (best < 0 || ns < best)
+	best = ns;
+    }
+
+  printf("%.1f ns/op, best of %d passes over %d ops\n", best, reps, n_ops);
+  free(ptrs);
+  free(sizes);
+  free(ops);
+  return 0;
+}
+
+void
+usage(char* name)
+{
+  fprintf(stderr, "usage: %s <trace> <passes>\n", name);
+  exit(1);
+}
+
+void
+error(char* msg, char* arg)
+{
+  fprintf(stderr, "error: %s %s\n", msg, arg);
+  exit(1);
+}
@@ -46,6 +46,7 @@
 /************Private include**********************************************/
 #include "kpage.h"
 #include "kma.h"
+#include "kma_class.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -80,15 +81,7 @@ typedef struct
 typedef struct
 {
 	kpage_t* pageInfo;
-	freeListInfo bytes32;
-	freeListInfo bytes64;
-	freeListInfo bytes128;
-	freeListInfo bytes256;
-	freeListInfo bytes512;
-	freeListInfo bytes1024;
-	freeListInfo bytes2048;
-	freeListInfo bytes4096;
-	freeListInfo bytes8192;
+	freeListInfo lists[NCLASSES];	// indexed by size class
 	int numAllocatedPages;
 } freeListPointers;
 
@@ -106,9 +99,7 @@ void* splitBuffer(buffer*, int);
 buffer* getBuddy(buffer*);
 void coalesceIfNecessary(buffer*);
 freeListInfo* getFreeList(int);
-int getBufferSize(int);
 void removeBufferFromFreeList(buffer*, freeListInfo*);
-int getOrder(int);
 
 /************External Declaration*****************************************/
 
@@ -122,19 +113,22 @@ void*
 kma_malloc(kma_size_t size)
 {
 	if (debug) printf("\nREQUEST %i\n", size);
-	if (entryPoint == 0) {
-		entryPoint = getEntryPoint();
-	}
-	
 	int adjustedSize = size + sizeof(buffer);
-	int bufferSize = getBufferSize(adjustedSize);
-	freeListInfo* freeList = getFreeList(bufferSize);
+	int class = kma_class(adjustedSize);
 	
-	if (freeList == NULL) {
+	// If the size we're given is bigger than the size of a page.
+	if (class < 0) {
 		return NULL;
 	}
 	
-	getSpaceIfNeeded(freeList, bufferSize);
+	if (entryPoint == 0) {
+		entryPoint = getEntryPoint();
+	}
+	
+	freeListPointers* freeLists = (freeListPointers*)entryPoint->ptr;
+	freeListInfo* freeList = &freeLists->lists[class];
+	
+	getSpaceIfNeeded(freeList, kma_class_size(class));
 	return getNextBuffer(freeList);
 }
 
@@ -187,7 +181,7 @@ void coalesceIfNecessary(buffer* aBuffer) {
 
 buffer* getBuddy(buffer* aBuffer) {
 	buffer* buddy = aBuffer;
-	int order = getOrder(aBuffer->size);
+	int order = kma_order(aBuffer->size);
 	// This will probably need to be changed to int on the tlab - long on 64-bit machines, int on 32-bit
 	long buddyAddr = (long)buddy;
 	buddyAddr ^= 1 << order;
@@ -203,41 +197,12 @@ kpage_t* getEntryPoint() {
 	
 	freeLists->pageInfo = entryPoint;
 	
-	freeLists->bytes32.nextBuffer = 0;
-	freeLists->bytes32.numAllocatedBuffers = 0;
-	freeLists->bytes32.firstPage = 0;
-	
-	freeLists->bytes64.nextBuffer = 0;
-	freeLists->bytes64.numAllocatedBuffers = 0;
-	freeLists->bytes64.firstPage = 0;
-	
-	freeLists->bytes128.nextBuffer = 0;
-	freeLists->bytes128.numAllocatedBuffers = 0;
-	freeLists->bytes128.firstPage = 0;
-	
-	freeLists->bytes256.nextBuffer = 0;
-	freeLists->bytes256.numAllocatedBuffers = 0;
-	freeLists->bytes256.firstPage = 0;
-	
-	freeLists->bytes512.nextBuffer = 0;
-	freeLists->bytes512.numAllocatedBuffers = 0;
-	freeLists->bytes512.firstPage = 0;
-	
-	freeLists->bytes1024.nextBuffer = 0;
-	freeLists->bytes1024.numAllocatedBuffers = 0;
-	freeLists->bytes1024.firstPage = 0;
-	
-	freeLists->bytes2048.nextBuffer = 0;
-	freeLists->bytes2048.numAllocatedBuffers = 0;
-	freeLists->bytes2048.firstPage = 0;
-	
-	freeLists->bytes4096.nextBuffer = 0;
-	freeLists->bytes4096.numAllocatedBuffers = 0;
-	freeLists->bytes4096.firstPage = 0;
-	
-	freeLists->bytes8192.nextBuffer = 0;
-	freeLists->bytes8192.numAllocatedBuffers = 0;
-	freeLists->bytes8192.firstPage = 0;
+	int i;
+	for (i = 0; i < NCLASSES; i++) {
+		freeLists->lists[i].nextBuffer = 0;
+		freeLists->lists[i].numAllocatedBuffers = 0;
+		freeLists->lists[i].firstPage = 0;
+	}
 	
 	freeLists->numAllocatedPages = 0;
 	
@@ -378,124 +343,9 @@ void* splitBuffer(buffer* largeBuffer, int size) {
 
 freeListInfo* getFreeList(int size) {
 	freeListPointers* freeLists = (freeListPointers*)entryPoint->ptr;
+	int class = kma_class(size);
 	
-	if (size <= 32) {
-		return &freeLists->bytes32;
-	}
-	
-	if (size <= 64) {
-		return &freeLists->bytes64;
-	}
-	
-	if (size <= 128) {
-		return &freeLists->bytes128;
-	}
-	
-	if (size <= 256) {
-		return &freeLists->bytes256;
-	}
-	
-	if (size <= 512) {
-		return &freeLists->bytes512;
-	}
-	
-	if (size <= 1024) {
-		return &freeLists->bytes1024;
-	}
-	
-	if (size <= 2048) {
-		return &freeLists->bytes2048;
-	}
-	
-	if (size <= 4096) {
-		return &freeLists->bytes4096;
-	}
-	
-	if (size <= 8192) {
-		return &freeLists->bytes8192;
-	}
-	
-	return NULL;
-}
-
-int getBufferSize(int size) {
-	if (size <= 32) {
-		return 32;
-	}
-	
-	if (size <= 64) {
-		return 64;
-	}
-	
-	if (size <= 128) {
-		return 128;
-	}
-	
-	if (size <= 256) {
-		return 256;
-	}
-	
-	if (size <= 512) {
-		return 512;
-	}
-	
-	if (size <= 1024) {
-		return 1024;
-	}
-	
-	if (size <= 2048) {
-		return 2048;
-	}
-	
-	if (size <= 4096) {
-		return 4096;
-	}
-	
-	if (size <= 8192) {
-		return 8192;
-	}
-	
-	return 0;
-}
-
-int getOrder(int size) {
-	if (size <= 32) {
-		return 5;
-	}
-	
-	if (size <= 64) {
-		return 6;
-	}
-	
-	if (size <= 128) {
-		return 7;
-	}
-	
-	if (size <= 256) {
-		return 8;
-	}
-	
-	if (size <= 512) {
-		return 9;
-	}
-	
-	if (size <= 1024) {
-		return 10;
-	}
-	
-	if (size <= 2048) {
-		return 11;
-	}
-	
-	if (size <= 4096) {
-		return 12;
-	}
-	
-	if (size <= 8192) {
-		return 13;
-	}
-	
-	return 0;
+	return class < 0 ? NULL : &freeLists->lists[class];
 }
 
 #endif // KMA_BUD
@@ -0,0 +1,78 @@
+/***************************************************************************
+ *  Title: Kernel Memory Allocator
+ * -------------------------------------------------------------------------
+ *    Purpose: Power-of-two size classes shared by the allocators
+ *    File: kma_class.h
+ ***************************************************************************/
+
+#ifndef __KMA_CLASS_H__
+#define __KMA_CLASS_H__
+
+/************System include***********************************************/
+
+/************Private include**********************************************/
+#include "kpage.h"
+
+/************Defines and Typedefs*****************************************/
+/*  #defines and typedefs should have their names in all caps.
+ *  Global variables begin with g. Global constants with k. Local
+ *  variables should be in all lower case. When initializing
+ *  structures and arrays, line everything up in neat columns.
+ */
+
+#define MINORDER 5                              /* 32 bytes */
+#define MAXORDER 13                             /* 8192 bytes, a page */
+#define NCLASSES (MAXORDER - MINORDER + 1)
+
+#if (1 << MAXORDER) != PAGESIZE
+#error "the largest size class must be a page"
+#endif
+
+/************Function Prototypes******************************************/
+
+/***********************************************************************
+ *  Title: Order of a size
+ * ---------------------------------------------------------------------
+ *    Purpose: Get the log2 of the smallest power of two that holds
+ *             size bytes, and no less than MINORDER.  Or-ing in the
+ *             bits below MINORDER rounds small sizes up without a
+ *             branch; size must be positive.
+ *    Input: size in bytes
+ *    Output: the order
+ ***********************************************************************/
+static inline int
+kma_order(int size)
+{
+  return 32 - __builtin_clz((unsigned)(size - 1) | ((1 << MINORDER) - 1));
+}
+
+/***********************************************************************
+ *  Title: Size class of a size
+ * ---------------------------------------------------------------------
+ *    Purpose: Get the index of the smallest size class that holds
+ *             size bytes
+ *    Input: size in bytes
+ *    Output: the class, 0 to NCLASSES - 1, or -1 if larger than a page
+ ***********************************************************************/
+static inline int
+kma_class(int size)
+{
+  int order = kma_order(size);
+
+  return order <= MAXORDER ? order - MINORDER : -1;
+}
+
+/***********************************************************************
+ *  Title: Size of a size class
+ * ---------------------------------------------------------------------
+ *    Purpose: Get the buffer size of a size class
+ *    Input: the class
+ *    Output: its size in bytes
+ ***********************************************************************/
+static inline int
+kma_class_size(int class)
+{
+  return 1 << (class + MINORDER);
+}
+
+#endif /* __KMA_CLASS_H__ */
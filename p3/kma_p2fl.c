@@ -46,6 +46,7 @@
 /************Private include**********************************************/
 #include "kpage.h"
 #include "kma.h"
+#include "kma_class.h"
 
 /************Defines and Typedefs*****************************************/
 /*  #defines and typedefs should have their names in all caps.
@@ -77,15 +78,7 @@ typedef struct
 typedef struct
 {
 	kpage_t* page_info;
-	free_list_info bytes32;
-	free_list_info bytes64;
-	free_list_info bytes128;
-	free_list_info bytes256;
-	free_list_info bytes512;
-	free_list_info bytes1024;
-	free_list_info bytes2048;
-	free_list_info bytes4096;
-	free_list_info bytes8192;
+	free_list_info lists[NCLASSES];	// indexed by size class
 	int numAllocatedPages;
 } free_list_pointers;
 
@@ -115,81 +108,21 @@ kma_malloc(kma_size_t size)
 	
 	free_list_pointers* free_lists = (free_list_pointers*)entry_point->ptr;
 	
+	// A buffer is always larger than what it holds, so one byte more
+	// picks the class.
 	int adjusted_size = size + sizeof(void*);
-	if (adjusted_size < 32) {
-		free_list_info* free_list = &free_lists->bytes32;
-
-		get_space_if_needed(free_list, 32);
-		
-		return get_next_buffer(free_list);
-	}
-	
-	if (adjusted_size < 64) {
-		free_list_info* free_list = &free_lists->bytes64;
-		
-		get_space_if_needed(free_list, 64);
-		
-		return get_next_buffer(free_list);
-	}
-	
-	if (adjusted_size < 128) {
-		free_list_info* free_list = &free_lists->bytes128;
-		
-		get_space_if_needed(free_list, 128);
-		
-		return get_next_buffer(free_list);
-	}
-	
-	if (adjusted_size < 256) {
-		free_list_info* free_list = &free_lists->bytes256;
-		
-		get_space_if_needed(free_list, 256);
-		
-		return get_next_buffer(free_list);
-	}
-	
-	if (adjusted_size < 512) {
-		free_list_info* free_list = &free_lists->bytes512;
-		
-		get_space_if_needed(free_list, 512);
-		
-		return get_next_buffer(free_list);
-	}
-	
-	if (adjusted_size < 1024) {
-		free_list_info* free_list = &free_lists->bytes1024;
-		
-		get_space_if_needed(free_list, 1024);
-		
-		return get_next_buffer(free_list);
-	}
+	int class = kma_class(adjusted_size + 1);
 	
-	if (adjusted_size < 2048) {
-		free_list_info* free_list = &free_lists->bytes2048;
-		
-		get_space_if_needed(free_list, 2048);
-		
-		return get_next_buffer(free_list);
+	// If the size we're given is bigger than the size of a page.
+	if (class < 0) {
+		return NULL;
 	}
 	
-	if (adjusted_size < 4096) {
-		free_list_info* free_list = &free_lists->bytes4096;
-		
-		get_space_if_needed(free_list, 4096);
-		
-		return get_next_buffer(free_list);
-	}
+	free_list_info* free_list = &free_lists->lists[class];
 	
-	if (adjusted_size < 8192) {
-		free_list_info* free_list = &free_lists->bytes8192;
-		
-		get_space_if_needed(free_list, 8192);
-		
-		return get_next_buffer(free_list);
-	}
+	get_space_if_needed(free_list, kma_class_size(class));
 	
-	// If the size we're given is bigger than the size of a page.
-	return NULL;
+	return get_next_buffer(free_list);
 }
 
 void
@@ -234,41 +167,12 @@ kpage_t* get_entry_point() {
 	
 	free_lists->page_info = entry_point;
 	
-	free_lists->bytes32.next_buffer = 0;
-	free_lists->bytes32.numAllocatedBuffers = 0;
-	free_lists->bytes32.first_page = 0;
-	
-	free_lists->bytes64.next_buffer = 0;
-	free_lists->bytes64.numAllocatedBuffers = 0;
-	free_lists->bytes64.first_page = 0;
-	
-	free_lists->bytes128.next_buffer = 0;
-	free_lists->bytes128.numAllocatedBuffers = 0;
-	free_lists->bytes128.first_page = 0;
-	
-	free_lists->bytes256.next_buffer = 0;
-	free_lists->bytes256.numAllocatedBuffers = 0;
-	free_lists->bytes256.first_page = 0;
-	
-	free_lists->bytes512.next_buffer = 0;
-	free_lists->bytes512.numAllocatedBuffers = 0;
-	free_lists->bytes512.first_page = 0;
-	
-	free_lists->bytes1024.next_buffer = 0;
-	free_lists->bytes1024.numAllocatedBuffers = 0;
-	free_lists->bytes1024.first_page = 0;
-	
-	free_lists->bytes2048.next_buffer = 0;
-	free_lists->bytes2048.numAllocatedBuffers = 0;
-	free_lists->bytes2048.first_page = 0;
-	
-	free_lists->bytes4096.next_buffer = 0;
-	free_lists->bytes4096.numAllocatedBuffers = 0;
-	free_lists->bytes4096.first_page = 0;
-	
-	free_lists->bytes8192.next_buffer = 0;
-	free_lists->bytes8192.numAllocatedBuffers = 0;
-	free_lists->bytes8192.first_page = 0;
+	int i;
+	for (i = 0; i < NCLASSES; i++) {
+		free_lists->lists[i].next_buffer = 0;
+		free_lists->lists[i].numAllocatedBuffers = 0;
+		free_lists->lists[i].first_page = 0;
+	}
 	
 	free_lists->numAllocatedPages = 0;
 	